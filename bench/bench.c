@@ -0,0 +1,239 @@
+/*
+    nanabozo - tool for CHTML script-coding
+    Copyright (C) 2018-2020 Stanislas Marquis <stan@astrorigin.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+/*
+ *  nanabozo_bench - translation throughput of nanabozo
+ *
+ *  Runs nanabozo over each script (or each .php script of a directory),
+ *  a few times, and reports the best time as MB/s of input, with the peak
+ *  resident size of the process and the size of its output:
+ *
+ *      nanabozo_bench -r 5 -O -b ./nanabozo corpus
+ *
+ *  Options given with -O are passed to nanabozo, before the script.
+ */
+
+#include <dirent.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+
+#define MAX_OPTIONS 32
+
+struct bench_result
+{
+    double secs;            /* best of the runs */
+    long maxrss;            /* kB, highest of the runs */
+    off_t outsize;
+};
+
+int bench_dir( const char *path );
+int bench_file( const char *path );
+int run_once( const char *path, const char *outpath, double *secs,
+        long *maxrss );
+int cmp_names( const void *a, const void *b );
+
+const char *_nanabozo = NULL;
+const char *_options[MAX_OPTIONS];
+int _noptions = 0;
+int _runs = 3;
+
+int main(int argc, char *argv[])
+{
+    struct stat st;
+    int c, i, err = 0;
+
+    while ((c = getopt(argc, argv, "r:O:h")) != -1) {
+        switch (c) {
+        case 'r':
+            if ((_runs = atoi(optarg)) < 1) {
+                fputs("nanabozo_bench: bad number of runs\n", stderr);
+                return EXIT_FAILURE;
+            }
+            break;
+        case 'O':
+            if (_noptions == MAX_OPTIONS) {
+                fputs("nanabozo_bench: too many options\n", stderr);
+                return EXIT_FAILURE;
+            }
+            _options[_noptions++] = optarg;
+            break;
+        default:
+            fputs("usage: nanabozo_bench [-r runs] [-O option]..."
+                    " nanabozo (script|dir)...\n", stderr);
+            return c == 'h' ? EXIT_SUCCESS : EXIT_FAILURE;
+        }
+    }
+    if (argc - optind < 2) {
+        fputs("usage: nanabozo_bench [-r runs] [-O option]..."
+                " nanabozo (script|dir)...\n", stderr);
+        return EXIT_FAILURE;
+    }
+    _nanabozo = argv[optind++];
+
+    printf("%-16s %9s %9s %9s %10s %12s\n", "case", "input MB", "best ms",
+            "MB/s", "peak kB", "output");
+    for (i = optind; i < argc; i++) {
+        if (stat(argv[i], &st) != 0) {
+            fprintf(stderr, "nanabozo_bench: unable to stat '%s'\n", argv[i]);
+            err = 1;
+        }
+        else if (S_ISDIR(st.st_mode)) {
+            err |= bench_dir(argv[i]);
+        }
+        else {
+            err |= bench_file(argv[i]);
+        }
+    }
+    return err ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+int bench_dir( const char *path )
+{
+    DIR *d;
+    struct dirent *ent;
+    char **names = NULL, fpath[4096];
+    size_t len = 0, sz = 0, i, n;
+    int err = 0;
+
+    if (!(d = opendir(path))) {
+        fprintf(stderr, "nanabozo_bench: unable to open '%s'\n", path);
+        return 1;
+    }
+    while ((ent = readdir(d))) {
+        n = strlen(ent->d_name);
+        if (n < 5 || strcmp(ent->d_name + n - 4, ".php") != 0) {
+            continue;
+        }
+        if (len == sz) {
+            sz = sz ? sz * 2 : 16;
+            if (!(names = realloc(names, sz * sizeof(char*)))) {
+                perror("nanabozo_bench");
+                exit(EXIT_FAILURE);
+            }
+        }
+        if (!(names[len++] = strdup(ent->d_name))) {
+            perror("nanabozo_bench");
+            exit(EXIT_FAILURE);
+        }
+    }
+    closedir(d);
+    /* same order on every run */
+    qsort(names, len, sizeof(char*), &cmp_names);
+    for (i = 0; i < len; i++) {
+        snprintf(fpath, sizeof(fpath), "%s/%s", path, names[i]);
+        err |= bench_file(fpath);
+        free(names[i]);
+    }
+    free(names);
+    return err;
+}
+int bench_file( const char *path )
+{
+    struct bench_result res = { 0, 0, 0 };
+    struct stat st;
+    char outpath[4096];
+    const char *name;
+    double secs, mb;
+    long maxrss;
+    int i;
+
+    if (stat(path, &st) != 0) {
+        fprintf(stderr, "nanabozo_bench: unable to stat '%s'\n", path);
+        return 1;
+    }
+    snprintf(outpath, sizeof(outpath), "%s.out.c", path);
+    for (i = 0; i < _runs; i++) {
+        if (run_once(path, outpath, &secs, &maxrss) != 0) {
+            unlink(outpath);
+            return 1;
+        }
+        if (i == 0 || secs < res.secs) {
+            res.secs = secs;
+        }
+        if (maxrss > res.maxrss) {
+            res.maxrss = maxrss;
+        }
+    }
+    if (stat(outpath, &st) == 0) {
+        res.outsize = st.st_size;
+    }
+    unlink(outpath);
+    stat(path, &st);
+    mb = (double) st.st_size / (1 << 20);
+    name = (name = strrchr(path, '/')) ? name + 1 : path;
+    printf("%-16s %9.2f %9.1f %9.1f %10ld %12lld\n", name, mb,
+            res.secs * 1000, res.secs > 0 ? mb / res.secs : 0, res.maxrss,
+            (long long) res.outsize);
+    fflush(stdout);
+    return 0;
+}
+int run_once( const char *path, const char *outpath, double *secs,
+        long *maxrss )
+{
+    const char *args[MAX_OPTIONS + 4];
+    struct timespec t0, t1;
+    struct rusage ru;
+    pid_t pid;
+    int i, n = 0, status;
+
+    args[n++] = _nanabozo;
+    for (i = 0; i < _noptions; i++) {
+        args[n++] = _options[i];
+    }
+    args[n++] = path;
+    args[n++] = outpath;
+    args[n] = NULL;
+
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    if ((pid = fork()) < 0) {
+        perror("nanabozo_bench");
+        return 1;
+    }
+    if (pid == 0) {
+        execvp(args[0], (char *const *) args);
+        perror("nanabozo_bench");
+        _exit(127);
+    }
+    /* rusage of that child only, not of all children */
+    if (wait4(pid, &status, 0, &ru) < 0) {
+        perror("nanabozo_bench");
+        return 1;
+    }
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+        fprintf(stderr, "nanabozo_bench: nanabozo failed on '%s'\n", path);
+        return 1;
+    }
+    *secs = (t1.tv_sec - t0.tv_sec) + (t1.tv_nsec - t0.tv_nsec) / 1e9;
+    *maxrss = ru.ru_maxrss;
+    return 0;
+}
+int cmp_names( const void *a, const void *b )
+{
+    return strcmp(*(char *const *) a, *(char *const *) b);
+}
+
+/* vi: set fenc=utf-8 ff=unix sw=4 ts=4 sts=4 et ai : */
@@ -0,0 +1,321 @@
+/*
+    nanabozo - tool for CHTML script-coding
+    Copyright (C) 2018-2020 Stanislas Marquis <stan@astrorigin.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+/*
+ *  nanabozo_corpus - synthetic CHTML scripts for nanabozo_bench
+ *
+ *  Writes one script per case in the given directory, each of about the
+ *  given size (in MB, 16 by default). Scripts are made from a fixed seed,
+ *  so that runs can be compared release over release:
+ *
+ *      nanabozo_corpus corpus 16
+ *      nanabozo_bench nanabozo corpus
+ */
+
+#include <errno.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef _MSC_VER
+#include <sys/stat.h>
+#else
+#include <direct.h>
+#define mkdir(path, mode) _mkdir(path)
+#endif
+
+#ifndef READSIZE
+#define READSIZE 65536
+#endif
+
+struct corpus_case
+{
+    const char *name;
+    const char *what;
+    void (*gen)( void );
+};
+
+void gen_html( void );
+void gen_c( void );
+void gen_script( void );
+void gen_comments( void );
+void gen_longlines( void );
+void gen_regions( void );
+
+void emit( const char *fmt, ... );
+void emit_text( const size_t len );
+uint64_t rnd( void );
+size_t pick( const size_t n );
+
+static const struct corpus_case _cases[] =
+{
+    { "html",       "html heavy, tags and attributes", &gen_html },
+    { "c",          "C heavy, strings, comments and macros", &gen_c },
+    { "script",     "script and style heavy", &gen_script },
+    { "comments",   "html, script and style comments", &gen_comments },
+    { "longlines",  "lines of READSIZE bytes", &gen_longlines },
+    { "regions",    "many small <?= ?> regions", &gen_regions },
+    { NULL, NULL, NULL }
+};
+
+static const char *const _words[] =
+{
+    "lorem", "ipsum", "dolor", "sit", "amet", "consectetur", "adipiscing",
+    "elit", "sed", "do", "eiusmod", "tempor", "incididunt", "ut", "labore",
+    "et", "dolore", "magna", "aliqua", "enim", "ad", "minim", "veniam",
+    "quis", "nostrud", "exercitation", "ullamco", "laboris", "nisi",
+    "aliquip", "ex", "ea", "commodo", "consequat"
+};
+#define NWORDS (sizeof(_words) / sizeof(_words[0]))
+
+FILE *_out = NULL;
+size_t _written = 0;
+uint64_t _seed = 0;
+
+int main(int argc, char *argv[])
+{
+    const struct corpus_case *c;
+    char fpath[4096];
+    size_t target = 16;
+
+    if (argc < 2 || argc > 3 || (argc == 3 && !(target = strtoul(argv[2],
+                        NULL, 10))))
+    {
+        fputs("usage: nanabozo_corpus <dir> [size in MB]\n", stderr);
+        return EXIT_FAILURE;
+    }
+    if (mkdir(argv[1], 0777) != 0 && errno != EEXIST) {
+        fprintf(stderr, "nanabozo_corpus: unable to create '%s'\n", argv[1]);
+        return EXIT_FAILURE;
+    }
+    target <<= 20;
+    for (c = _cases; c->name; c++) {
+        snprintf(fpath, sizeof(fpath), "%s/%s.php", argv[1], c->name);
+        if (!(_out = fopen(fpath, "wb"))) {
+            fprintf(stderr, "nanabozo_corpus: unable to open '%s'\n", fpath);
+            return EXIT_FAILURE;
+        }
+        /* same script for the same size */
+        _seed = 0x9e3779b97f4a7c15ULL;
+        _written = 0;
+        emit("<? /* %s */ ?>\n", c->what);
+        while (_written < target) {
+            (*c->gen)();
+        }
+        if (fclose(_out) != 0) {
+            fprintf(stderr, "nanabozo_corpus: unable to write '%s'\n", fpath);
+            return EXIT_FAILURE;
+        }
+        printf("%-12s %8.1f MB  %s\n", c->name,
+                (double) _written / (1 << 20), c->what);
+    }
+    return EXIT_SUCCESS;
+}
+void gen_html( void )
+{
+    size_t i, n = 2 + pick(6);
+
+    emit("<div class=\"card card-%zu\" id=\"c%llu\">\n", pick(12),
+            (unsigned long long) (rnd() % 100000));
+    emit("  <h2 class=\"title\">");
+    emit_text(3 + pick(5));
+    emit("</h2>\n  <table class=\"data\" summary=\"list\">\n");
+    for (i = 0; i < n; i++) {
+        emit("    <tr><td class=\"k\">");
+        emit_text(1 + pick(2));
+        emit("</td><td class=\"v\"><a href=\"/item/%zu?ref=list&amp;p=%zu\""
+                " title=\"", pick(10000), pick(50));
+        emit_text(2);
+        emit("\">");
+        emit_text(1 + pick(4));
+        emit("</a></td></tr>\n");
+    }
+    emit("  </table>\n  <p>");
+    emit_text(20 + pick(40));
+    emit("</p>\n");
+    if (!pick(8)) {
+        /* now and then, a bit of C */
+        emit("<? if (show_footer) { ?>\n  <p class=\"foot\">");
+        emit_text(4);
+        emit("</p>\n<? } ?>\n");
+    }
+    emit("</div>\n");
+}
+void gen_c( void )
+{
+    size_t i, n = 3 + pick(8);
+
+    emit("<?\n/*\n * ");
+    emit_text(8 + pick(8));
+    emit("\n */\n#define FIELD_%zu(x) \\\n    ((x) * %zu + \\\n     %zu)\n",
+            pick(1000), pick(100), pick(100));
+    emit("static int compute_%zu(const char *s, int n)\n{\n"
+            "    int i, acc = 0;\n", pick(100000));
+    for (i = 0; i < n; i++) {
+        switch (pick(5)) {
+        case 0:
+            emit("    // single line comment, with ?> inside\n");
+            break;
+        case 1:
+            emit("    acc += s[i %% n] == '\\'' ? %zu : '\"';\n", pick(99));
+            break;
+        case 2:
+            emit("    if (!strcmp(s, \"value \\\"%zu\\\" ?> <p>\")) {\n"
+                    "        acc ^= 0x%zx;\n    }\n", pick(99), pick(4096));
+            break;
+        case 3:
+            emit("    for (i = 0; i < n; i++) { acc = acc * 31 + s[i]; }"
+                    " /* hash */\n");
+            break;
+        default:
+            emit("    print(\"<span>\"); /* %zu */\n", pick(999));
+            break;
+        }
+    }
+    emit("    return acc;\n}\n?>\n<p>");
+    emit_text(6);
+    emit("</p>\n");
+}
+void gen_script( void )
+{
+    size_t i, n = 3 + pick(6);
+
+    emit("<script type=\"text/javascript\">\n");
+    for (i = 0; i < n; i++) {
+        switch (pick(5)) {
+        case 0:
+            emit("  var s%zu = \"a \\\"quoted\\\" </p> string\";\n", pick(99));
+            break;
+        case 1:
+            emit("  var t%zu = 'it\\'s < %zu > &';\n", pick(99), pick(99));
+            break;
+        case 2:
+            emit("  var u%zu = `template ${x} with \"quotes\" and 'more'`;\n",
+                    pick(99));
+            break;
+        case 3:
+            emit("  if (a < b && b > c) { el.innerHTML = '<b>' + x + '</b>'; }"
+                    "\n");
+            break;
+        default:
+            emit("  document.getElementById(\"n%zu\").className = \"on\";\n",
+                    pick(999));
+            break;
+        }
+    }
+    emit("</script>\n<style>\n");
+    for (i = 0; i < n; i++) {
+        emit("  .c%zu > a[href^=\"http\"], .d%zu:hover { color: #%06zx;"
+                " margin: %zupx %zupx; }\n", pick(99), pick(99),
+                pick(0x1000000), pick(20), pick(20));
+    }
+    emit("</style>\n<p>");
+    emit_text(4);
+    emit("</p>\n");
+}
+void gen_comments( void )
+{
+    emit("<!--\n  ");
+    emit_text(10 + pick(20));
+    emit("\n  <p>commented out</p> -->\n");
+    if (!pick(6)) {
+        emit("<!--[if lt IE 9]><script src=\"html5shiv.js\"></script>"
+                "<![endif]-->\n");
+    }
+    emit("<script>\n  /* ");
+    emit_text(8 + pick(16));
+    emit(" */\n  var x = 1; // ");
+    emit_text(6);
+    emit("\n</script>\n<style>\n  /* ");
+    emit_text(8 + pick(16));
+    emit(" */\n  p { margin: 0; }\n</style>\n<p>");
+    emit_text(3);
+    emit("</p>\n");
+}
+void gen_longlines( void )
+{
+    const size_t start = _written;
+
+    /* a whole line, and a value in it now and then */
+    while (_written - start < READSIZE - 128) {
+        emit("<span class=\"w%zu\">", pick(9));
+        emit_text(1 + pick(3));
+        emit("</span>");
+        if (!pick(64)) {
+            emit("<?= names[%zu] ?>", pick(16));
+        }
+    }
+    emit("\n");
+}
+void gen_regions( void )
+{
+    switch (pick(4)) {
+    case 0:
+        emit("<li><?= row->name ?></li>");
+        break;
+    case 1:
+        emit("<td class=\"n\"><?%%d row->count ?></td>");
+        break;
+    case 2:
+        emit("<a title=\"<?- row->title ?>\"><?- row->label ?></a>");
+        break;
+    default:
+        emit("<?% \"%%s=%%d\", row->key, row->value ?>");
+        break;
+    }
+    if (!pick(4)) {
+        emit("\n");
+    }
+}
+void emit( const char *fmt, ... )
+{
+    va_list ap;
+    int n;
+
+    va_start(ap, fmt);
+    n = vfprintf(_out, fmt, ap);
+    va_end(ap);
+    if (n > 0) {
+        _written += (size_t) n;
+    }
+}
+void emit_text( const size_t len )
+{
+    size_t i;
+
+    for (i = 0; i < len; i++) {
+        emit(i ? " %s" : "%s", _words[pick(NWORDS)]);
+    }
+}
+uint64_t rnd( void )
+{
+    /* xorshift64* */
+    _seed ^= _seed >> 12;
+    _seed ^= _seed << 25;
+    _seed ^= _seed >> 27;
+    return _seed * 0x2545f4914f6cdd1dULL;
+}
+size_t pick( const size_t n )
+{
+    return (size_t) (rnd() % n);
+}
+
+/* vi: set fenc=utf-8 ff=unix sw=4 ts=4 sts=4 et ai : */
@@ -0,0 +1,54 @@
+<?
+/*
+ *  Article, mostly html with a few values.
+ */
+?>
+<!DOCTYPE html>
+<html lang="en">
+ <head>
+  <meta charset="utf-8">
+  <title><?= bench_title ?></title>
+  <link rel="stylesheet" href="/static/site.css">
+  <style>
+    body { font-family: sans-serif; margin: 0 auto; max-width: 48em; }
+    h1, h2 { font-weight: normal; }
+    .byline { color: #666; font-size: small; }
+  </style>
+ </head>
+ <body>
+  <header>
+   <nav>
+    <a href="/">Home</a> | <a href="/inventory">Inventory</a> |
+    <a href="/reports">Reports</a> | <a href="/account">Account</a>
+   </nav>
+  </header>
+  <article>
+   <h1><?= bench_title ?></h1>
+   <p class="byline">By <?= bench_user ?>, <?%d bench_nitems ?> items reviewed.</p>
+   <p>Lorem ipsum dolor sit amet, consectetur adipiscing elit, sed do eiusmod
+   tempor incididunt ut labore et dolore magna aliqua. Ut enim ad minim veniam,
+   quis nostrud exercitation ullamco laboris nisi ut aliquip ex ea commodo
+   consequat. Duis aute irure dolor in reprehenderit in voluptate velit esse
+   cillum dolore eu fugiat nulla pariatur.</p>
+   <h2>Stock levels</h2>
+   <p>Excepteur sint occaecat cupidatat non proident, sunt in culpa qui officia
+   deserunt mollit anim id est laborum. Sed ut perspiciatis unde omnis iste
+   natus error sit voluptatem accusantium doloremque laudantium, totam rem
+   aperiam, eaque ipsa quae ab illo inventore veritatis et quasi architecto
+   beatae vitae dicta sunt explicabo.</p>
+   <blockquote>Nemo enim ipsam voluptatem quia voluptas sit aspernatur aut odit
+   aut fugit, sed quia consequuntur magni dolores eos qui ratione voluptatem
+   sequi nesciunt.</blockquote>
+   <h2>Pricing</h2>
+   <p>Neque porro quisquam est, qui dolorem ipsum quia dolor sit amet,
+   consectetur, adipisci velit, sed quia non numquam eius modi tempora incidunt
+   ut labore et dolore magnam aliquam quaerat voluptatem. Ut enim ad minima
+   veniam, quis nostrum exercitationem ullam corporis suscipit laboriosam, nisi
+   ut aliquid ex ea commodi consequatur.</p>
+   <p>Cheapest item: <?= bench_items[1].name ?>, at <?% "%.2f", bench_items[1].price ?>.</p>
+  </article>
+  <footer>
+   <p>&copy; 2020 Example Hardware. All rights reserved.</p>
+  </footer>
+ </body>
+</html>
@@ -0,0 +1,21 @@
+<?
+/*
+ *  Form, user values escaped in text, attributes and script.
+ */
+int i;
+?>
+<form method="get" action="/search">
+ <p>Signed in as <?- bench_user ?>.</p>
+ <label>Search <input name="q" value="<?- bench_query ?>"></label>
+ <select name="item">
+<? for (i = 0; i < bench_nitems; i++) { ?>
+  <option value="<?- bench_items[i].name ?>" title="<?- bench_items[i].title ?>"><?- bench_items[i].title ?></option>
+<? } ?>
+ </select>
+ <p>Results for <?- bench_query ?></p>
+ <button type="submit">Go</button>
+</form>
+<script>
+  var user = "<?- bench_user ?>";
+  var query = "<?- bench_query ?>";
+</script>
@@ -0,0 +1,25 @@
+<?
+/*
+ *  Listing, a table of many small values.
+ */
+int i, total = 0;
+?>
+<table class="items">
+ <thead>
+  <tr><th>#</th><th>Name</th><th>Title</th><th>Stock</th><th>Price</th></tr>
+ </thead>
+ <tbody>
+<? for (i = 0; i < bench_nitems; i++) { total += bench_items[i].count; ?>
+  <?% "<tr class=\"%s\" id=\"item-%x\">", i % 2 ? "odd" : "even", bench_items[i].id ?>
+   <td><?%u bench_items[i].id ?></td>
+   <td><?% "<a href=\"/item/%s\">", bench_items[i].name ?><?= bench_items[i].name ?></a></td>
+   <td><?= bench_items[i].title ?></td>
+   <td class="n"><?%d bench_items[i].count ?></td>
+   <td class="n"><?% "%.2f", bench_items[i].price ?></td>
+  </tr>
+<? } ?>
+ </tbody>
+ <tfoot>
+  <tr><td colspan="3">Total</td><td class="n"><?%d total ?></td><td></td></tr>
+ </tfoot>
+</table>
@@ -0,0 +1,216 @@
+/*
+    nanabozo - tool for CHTML script-coding
+    Copyright (C) 2018-2020 Stanislas Marquis <stan@astrorigin.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+/*
+ *  nanabozo_render - rendering cost of translated pages
+ *
+ *  Linked with the reference pages (bench/pages) translated with one set
+ *  of options, it renders each page in process, many times, to /dev/null
+ *  (stdout) or to a memory sink (-p, -P and -f), and reports requests/s,
+ *  ns per output byte and output calls per page:
+ *
+ *      nanabozo_render -H sized 20000
+ *
+ *  The name is only printed, -H prints the header of the table first.
+ */
+
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "render.h"
+
+struct bench_page
+{
+    const char *name;
+    int (*render)( void );
+    int (*count)( void );
+};
+
+static const struct bench_page _pages[] =
+{
+    { "article",    &bench_article, &bench_article_count },
+    { "form",       &bench_form,    &bench_form_count },
+    { "list",       &bench_list,    &bench_list_count },
+    { NULL, NULL, NULL }
+};
+
+const char *bench_title = "Quarterly inventory & pricing";
+const char *bench_user = "Jean-Fran\xc3\xa7ois O'Brien";
+const char *bench_query = "<script>alert(\"q\")</script> & more";
+
+#define ITEM(n, t, c, i, p) { n, t, c, i, p }
+const struct bench_item bench_items[] =
+{
+    ITEM("anvil", "Anvil, \"heavy\" <cast iron>", 12, 1001, 149.90),
+    ITEM("bolt", "Bolt & nut, M8", 4800, 1002, 0.12),
+    ITEM("chisel", "Chisel 'wood' 20mm", 75, 1003, 11.50),
+    ITEM("drill", "Drill <cordless> 18V", 31, 1004, 89.00),
+    ITEM("epoxy", "Epoxy, 2 parts & hardener", 240, 1005, 7.25),
+    ITEM("file", "File, half round", 66, 1006, 9.99),
+    ITEM("gauge", "Gauge \"feeler\" set", 18, 1007, 14.40),
+    ITEM("hammer", "Hammer, claw 16oz", 142, 1008, 19.95),
+    ITEM("inker", "Inker <fine>", 9, 1009, 3.10),
+    ITEM("jigsaw", "Jigsaw & blades", 27, 1010, 64.00),
+    ITEM("knife", "Knife, utility", 390, 1011, 5.60),
+    ITEM("level", "Level 'torpedo' 9in", 58, 1012, 12.30),
+    ITEM("mallet", "Mallet, rubber", 73, 1013, 8.80),
+    ITEM("nails", "Nails <box of 500>", 1210, 1014, 4.45),
+    ITEM("pliers", "Pliers & cutters", 96, 1015, 13.70),
+    ITEM("rasp", "Rasp, \"cabinet\"", 22, 1016, 17.20),
+    ITEM("saw", "Saw, hand 22in", 44, 1017, 24.90),
+    ITEM("tape", "Tape measure <5m>", 310, 1018, 6.75),
+    ITEM("vise", "Vise, bench 4in", 7, 1019, 79.00),
+    ITEM("wrench", "Wrench & socket set", 35, 1020, 54.50)
+};
+#undef ITEM
+const int bench_nitems = sizeof(bench_items) / sizeof(bench_items[0]);
+
+struct bench_sink bench_out = { NULL, 0, 0 };
+unsigned long bench_calls = 0;
+unsigned long bench_bytes = 0;
+
+void sink_grow( const size_t n );
+double now( void );
+
+int main(int argc, char *argv[])
+{
+    const struct bench_page *pg;
+    const char *variant;
+    FILE *report;
+    unsigned long calls, bytes;
+    long i, iterations = 10000;
+    double t0, secs;
+    int header = 0;
+
+    if (argc > 1 && !strcmp(argv[1], "-H")) {
+        header = 1;
+        argc--;
+        argv++;
+    }
+    if (argc < 2 || argc > 3
+            || (argc == 3 && (iterations = atol(argv[2])) < 1)) {
+        fputs("usage: nanabozo_render [-H] <name> [iterations]\n", stderr);
+        return EXIT_FAILURE;
+    }
+    variant = argv[1];
+    /* pages print to stdout, the report goes to the real one */
+    if (!(report = fdopen(dup(STDOUT_FILENO), "w"))
+            || !freopen("/dev/null", "w", stdout)) {
+        perror("nanabozo_render");
+        return EXIT_FAILURE;
+    }
+    sink_grow(1 << 16);
+    if (header) {
+        fprintf(report, "%-10s %-8s %8s %7s %12s %8s\n", "variant", "page",
+                "bytes", "calls", "requests/s", "ns/byte");
+    }
+    for (pg = _pages; pg->name; pg++) {
+        bench_calls = bench_bytes = 0;
+        bench_out.len = 0;
+        (*pg->count)();
+        fflush(stdout);
+        calls = bench_calls;
+        bytes = bench_bytes;
+        /* warm up caches and the sink */
+        for (i = 0; i < 100; i++) {
+            bench_out.len = 0;
+            (*pg->render)();
+            fflush(stdout);
+        }
+        t0 = now();
+        for (i = 0; i < iterations; i++) {
+            bench_out.len = 0;
+            (*pg->render)();
+            fflush(stdout);
+        }
+        secs = now() - t0;
+        fprintf(report, "%-10s %-8s %8lu %7lu %12.0f %8.3f\n", variant,
+                pg->name, bytes, calls, iterations / secs,
+                bytes ? secs * 1e9 / ((double) iterations * bytes) : 0);
+    }
+    free(bench_out.buf);
+    return fclose(report) == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+void bench_sink_print( const char *s )
+{
+    bench_sink_print_n(s, strlen(s));
+}
+void bench_sink_print_n( const char *s, size_t n )
+{
+    if (bench_out.len + n > bench_out.sz) {
+        sink_grow(bench_out.len + n);
+    }
+    memcpy(bench_out.buf + bench_out.len, s, n);
+    bench_out.len += n;
+}
+int bench_sink_printf( const char *fmt, ... )
+{
+    va_list ap;
+    int n;
+
+    va_start(ap, fmt);
+    n = bench_sink_vprintf(fmt, ap);
+    va_end(ap);
+    return n;
+}
+int bench_sink_vprintf( const char *fmt, va_list ap )
+{
+    va_list aq;
+    int n;
+
+    va_copy(aq, ap);
+    n = vsnprintf(bench_out.buf + bench_out.len, bench_out.sz - bench_out.len,
+            fmt, aq);
+    va_end(aq);
+    if (n < 0) {
+        return n;
+    }
+    if (bench_out.len + n >= bench_out.sz) {
+        sink_grow(bench_out.len + n + 1);
+        n = vsnprintf(bench_out.buf + bench_out.len,
+                bench_out.sz - bench_out.len, fmt, ap);
+    }
+    bench_out.len += n;
+    return n;
+}
+void sink_grow( const size_t n )
+{
+    size_t sz = bench_out.sz ? bench_out.sz : 4096;
+
+    while (sz < n) {
+        sz *= 2;
+    }
+    if (sz != bench_out.sz) {
+        if (!(bench_out.buf = realloc(bench_out.buf, sz))) {
+            perror("nanabozo_render");
+            exit(EXIT_FAILURE);
+        }
+        bench_out.sz = sz;
+    }
+}
+double now( void )
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* vi: set fenc=utf-8 ff=unix sw=4 ts=4 sts=4 et ai : */
@@ -0,0 +1,147 @@
+/*
+    nanabozo - tool for CHTML script-coding
+    Copyright (C) 2018-2020 Stanislas Marquis <stan@astrorigin.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+/*
+ *  render.h - reference pages of nanabozo_render
+ *
+ *  Forced in each translated page (cc -include), before its own headers.
+ *  Pages are functions named with BENCH_PAGE(name), given to nanabozo
+ *  as prefix ('int BENCH_PAGE(list)(void) {'), or as main with --main
+ *  ('#define main BENCH_PAGE(list)').
+ *
+ *  Each page is compiled twice: as is, to be timed, and with BENCH_COUNT,
+ *  where the output functions are wrapped to count calls and bytes.
+ */
+
+#ifndef BENCH_RENDER_H
+#define BENCH_RENDER_H
+
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+
+struct bench_item
+{
+    const char *name;
+    const char *title;
+    int count;
+    unsigned id;
+    double price;
+};
+
+/* page data, in render.c */
+extern const char *bench_title;
+extern const char *bench_user;
+extern const char *bench_query;
+extern const struct bench_item bench_items[];
+extern const int bench_nitems;
+
+/* memory sink, for -p, -P and -f */
+struct bench_sink
+{
+    char *buf;
+    size_t len;
+    size_t sz;
+};
+extern struct bench_sink bench_out;
+void bench_sink_print( const char *s );
+void bench_sink_print_n( const char *s, size_t n );
+int bench_sink_printf( const char *fmt, ... );
+int bench_sink_vprintf( const char *fmt, va_list ap );
+
+/* counted by pages compiled with BENCH_COUNT */
+extern unsigned long bench_calls;
+extern unsigned long bench_bytes;
+
+#define BENCH_DECLARE(name) \
+    int bench_##name( void ); \
+    int bench_##name##_count( void );
+BENCH_DECLARE(article)
+BENCH_DECLARE(form)
+BENCH_DECLARE(list)
+#undef BENCH_DECLARE
+
+#ifndef BENCH_COUNT
+#define BENCH_PAGE(name) bench_##name
+#else
+#define BENCH_PAGE(name) bench_##name##_count
+
+static inline int bench_fputs( const char *s, FILE *f )
+{
+    bench_calls++;
+    bench_bytes += strlen(s);
+    return fputs(s, f);
+}
+static inline size_t bench_fwrite( const void *p, size_t sz, size_t n,
+        FILE *f )
+{
+    bench_calls++;
+    bench_bytes += sz * n;
+    return fwrite(p, sz, n, f);
+}
+static inline int bench_printf( const char *fmt, ... )
+{
+    va_list ap;
+    int n;
+
+    va_start(ap, fmt);
+    n = vprintf(fmt, ap);
+    va_end(ap);
+    bench_calls++;
+    bench_bytes += n > 0 ? (unsigned long) n : 0;
+    return n;
+}
+static inline void bench_count_print( const char *s )
+{
+    bench_calls++;
+    bench_bytes += strlen(s);
+    bench_sink_print(s);
+}
+static inline void bench_count_print_n( const char *s, size_t n )
+{
+    bench_calls++;
+    bench_bytes += n;
+    bench_sink_print_n(s, n);
+}
+static inline int bench_count_printf( const char *fmt, ... )
+{
+    va_list ap;
+    int n;
+
+    va_start(ap, fmt);
+    n = bench_sink_vprintf(fmt, ap);
+    va_end(ap);
+    bench_calls++;
+    bench_bytes += n > 0 ? (unsigned long) n : 0;
+    return n;
+}
+
+/* fputs, fwrite and printf of the default print macros */
+#define fputs bench_fputs
+#define fwrite bench_fwrite
+#define printf bench_printf
+#define bench_sink_print bench_count_print
+#define bench_sink_print_n bench_count_print_n
+#define bench_sink_printf bench_count_printf
+#endif /* BENCH_COUNT */
+
+#endif /* BENCH_RENDER_H */
+
+/* vi: set fenc=utf-8 ff=unix sw=4 ts=4 sts=4 et ai : */
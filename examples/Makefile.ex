@@ -2,6 +2,9 @@
 
 CC = cc
 C++ = c++
+DESTDIR = /usr/local
+CFLAGS = -Wall -O2 -I$(DESTDIR)/include
+CXXFLAGS = $(CFLAGS) -std=c++17
 
 .DEFAULT_GOAL := build
 
@@ -9,25 +12,54 @@ basic.c: basic.php
 	nanabozo --main --html $< $@
 
 basic.cgi: basic.c
-	$(CC) -o $@ $<
+	$(CC) $(CFLAGS) -o $@ $<
 
 buffered_output.cpp: buffered_output.php
 	nanabozo -p ms.input -f ms.inputf $< $@
 
 buffered_output.cgi: buffered_output.cpp
-	$(C++) -o $@ $<
+	$(C++) $(CXXFLAGS) -o $@ $<
+
+cxx_page.cpp: cxx_page.php
+	nanabozo --cxx --main --html $< $@
+
+cxx_page.cgi: cxx_page.cpp
+	$(C++) $(CXXFLAGS) -o $@ $<
+
+escaped_output.c: escaped_output.php
+	nanabozo --main --html $< $@
+
+escaped_output.cgi: escaped_output.c
+	$(CC) $(CFLAGS) -o $@ $<
+
+response_buffer.c: response_buffer.php
+	nanabozo --buffer $< $@
+
+response_buffer.cgi: response_buffer.c
+	$(CC) $(CFLAGS) -o $@ $<
+
+fastcgi.c: fastcgi.php
+	nanabozo --fastcgi --html $< $@
+
+fastcgi.cgi: fastcgi.c
+	$(CC) $(CFLAGS) -o $@ $<
+
+fastcgi_client: fastcgi_client.c
+	$(CC) $(CFLAGS) -o $@ $<
 
 function.c: function.php
 	nanabozo $< $@
 
 function.cgi: function.c
-	$(CC) -o $@ $<
+	$(CC) $(CFLAGS) -o $@ $<
 
 .PHONY: build clean
 
-build: basic.cgi buffered_output.cgi function.cgi
+build: basic.cgi buffered_output.cgi cxx_page.cgi escaped_output.cgi \
+	fastcgi.cgi fastcgi_client function.cgi response_buffer.cgi
 
 clean:
-	rm -f *.c *.cpp *.cgi
+	rm -f basic.c escaped_output.c fastcgi.c function.c response_buffer.c \
+		*.cpp *.cgi fastcgi_client
 
 # vi: sw=4 ts=4 noet ft=make
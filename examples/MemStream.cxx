@@ -45,6 +45,20 @@ public:
     }
   }
 
+  void input_n( const char* txt, size_t len )
+  {
+    if (txt == NULL || len == 0) {
+      return;
+    }
+    if (m_file == NULL) {
+      init();
+    }
+    if (fwrite(txt, 1, len, m_file) != len) {
+      fputs("Unable to write memstream\n", stderr);
+      exit(EXIT_FAILURE);
+    }
+  }
+
   void inputf( const char* fmt, ... )
   {
     if (fmt == NULL || fmt[0] == '\0') {
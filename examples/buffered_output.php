@@ -3,6 +3,7 @@
  *  Buffered output example in C++.
  *  Compile with:
  *  nanabozo -p 'ms.input' -f 'ms.inputf' buffered_output.php
+ *  See response_buffer.php for the buffer shipped with nanabozo.
  */
 
 #include <iostream>
@@ -0,0 +1,27 @@
+<?
+/**
+ *  C++ page example, a function template over its output sink.
+ *  Compile with:
+ *  nanabozo --cxx --main --html cxx_page.php cxx_page.cpp
+ *  c++ -std=c++17 -o cxx_page.cgi cxx_page.cpp
+ *  (and -I the directory of nanabozo_cxx.h)
+ *  Without --main, include cxx_page.cpp and call nanabozo_page(sink).
+ */
+
+const std::string title = "Whatever";
+const std::string_view items[] = { "one", "two", "three" };
+?>
+<html>
+ <title><?= title ?></title>
+ <body>
+  <ul>
+<?
+for (const auto &item : items) {
+?>
+   <li><?= item ?> (<?% "%zu chars", item.size() ?>)</li>
+<?
+}
+?>
+  </ul>
+ </body>
+</html>
@@ -0,0 +1,25 @@
+<?
+/**
+ *  Escaped output example, echoing the query string.
+ *  Compile with:
+ *  nanabozo --main --html escaped_output.php
+ *  (and -I the directory of nanabozo_escape.h)
+ */
+
+#include <stdlib.h>
+
+const char *query = getenv("QUERY_STRING");
+?>
+<html>
+ <head>
+  <title>You asked for <?- query ?></title>
+ </head>
+ <body>
+  <input name="q" value="<?- query ?>">
+  <p>Query: <?- query ?></p>
+  <script>
+    var query = <?- query ?>;
+    console.log("query: <?- query ?>");
+  </script>
+ </body>
+</html>
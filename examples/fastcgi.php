@@ -0,0 +1,25 @@
+<?
+/**
+ *  FastCGI example, one process serves all requests.
+ *  Compile with:
+ *  nanabozo --fastcgi --html fastcgi.php
+ *  (and -I the directory of nanabozo_fastcgi.h)
+ *  Try with:
+ *  NANABOZO_FASTCGI=/tmp/fastcgi.sock ./fastcgi.cgi &
+ *  ./fastcgi_client /tmp/fastcgi.sock QUERY_STRING=name=World
+ */
+
+#define PAGE_TITLE "FastCGI Example"
+
+static unsigned long hits = 0; /* kept between requests */
+
+const char *query = request_param("QUERY_STRING");
+?>
+<html>
+  <head>
+    <title><?= PAGE_TITLE ?></title>
+  </head>
+  <body>
+    <p>Request <?% "%lu", ++hits ?>, query: <?= query ? query : "" ?></p>
+  </body>
+</html>
@@ -0,0 +1,275 @@
+/*
+ *  Minimal FastCGI client, to try pages translated with --fastcgi
+ *  without a web server.
+ *
+ *  Usage: fastcgi_client [-n count] [-i] [-q] <address> [NAME=VALUE ...]
+ *
+ *  address is a unix socket path (with a slash) or [host]:port, the
+ *  parameters are sent as request params (REQUEST_METHOD defaults to GET).
+ *  With -n, count requests are sent on the same connection and the rate is
+ *  printed on stderr. With -i, stdin is sent as request body. With -q, the
+ *  responses are read but not printed.
+ *  The exit status is the application status of the last request.
+ *
+ *  Compile with:
+ *  cc -o fastcgi_client fastcgi_client.c
+ */
+
+#include <errno.h>
+#include <netdb.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#define BEGIN_REQUEST   1
+#define END_REQUEST     3
+#define PARAMS          4
+#define STDIN           5
+#define STDOUT          6
+#define STDERR          7
+
+static char _params[65535];
+static size_t _params_len = 0;
+static char *_input = NULL;
+static size_t _input_len = 0;
+
+void fail( const char *msg )
+{
+    fprintf(stderr, "fastcgi_client: %s\n", msg);
+    exit(EXIT_FAILURE);
+}
+int connect_to( const char *addr )
+{
+    struct addrinfo hints, *res, *ai;
+    char host[256];
+    const char *port;
+    int fd = -1;
+    if (strchr(addr, '/')) {
+        struct sockaddr_un un;
+        if (strlen(addr) >= sizeof(un.sun_path)
+            || (fd = socket(AF_UNIX, SOCK_STREAM, 0)) < 0)
+        {
+            fail("invalid socket path");
+        }
+        memset(&un, 0, sizeof(un));
+        un.sun_family = AF_UNIX;
+        strcpy(un.sun_path, addr);
+        if (connect(fd, (struct sockaddr *) &un, sizeof(un)) != 0) {
+            fail(strerror(errno));
+        }
+        return fd;
+    }
+    if (!(port = strrchr(addr, ':')) || (size_t) (port - addr) >= sizeof(host)) {
+        fail("invalid address");
+    }
+    memcpy(host, addr, (size_t) (port - addr));
+    host[port - addr] = '\0';
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    if (getaddrinfo(*host ? host : "localhost", port + 1, &hints, &res) != 0) {
+        fail("invalid address");
+    }
+    for (ai = res; ai; ai = ai->ai_next) {
+        if ((fd = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol)) < 0) {
+            continue;
+        }
+        if (connect(fd, ai->ai_addr, ai->ai_addrlen) == 0) {
+            break;
+        }
+        close(fd);
+        fd = -1;
+    }
+    freeaddrinfo(res);
+    if (fd < 0) {
+        fail(strerror(errno));
+    }
+    return fd;
+}
+void put_length( size_t len )
+{
+    if (len < 128) {
+        _params[_params_len++] = (char) len;
+        return;
+    }
+    _params[_params_len++] = (char) ((len >> 24) | 0x80);
+    _params[_params_len++] = (char) (len >> 16);
+    _params[_params_len++] = (char) (len >> 8);
+    _params[_params_len++] = (char) len;
+}
+void add_param( const char *name, size_t nlen, const char *value )
+{
+    size_t vlen = strlen(value);
+    if (_params_len + nlen + vlen + 8 > sizeof(_params)) {
+        fail("too many params");
+    }
+    put_length(nlen);
+    put_length(vlen);
+    memcpy(_params + _params_len, name, nlen);
+    memcpy(_params + _params_len + nlen, value, vlen);
+    _params_len += nlen + vlen;
+}
+void write_all( int fd, const void *p, size_t len )
+{
+    while (len) {
+        ssize_t n = write(fd, p, len);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            fail("lost connection");
+        }
+        p = (const char *) p + n;
+        len -= (size_t) n;
+    }
+}
+void read_all( int fd, void *p, size_t len )
+{
+    while (len) {
+        ssize_t n = read(fd, p, len);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            fail("lost connection");
+        }
+        p = (char *) p + n;
+        len -= (size_t) n;
+    }
+}
+void send_record( int fd, int type, const char *p, size_t len )
+{
+    unsigned char h[8] = { 1, 0, 0, 1, 0, 0, 0, 0 };
+    do {
+        size_t k = len < 65535 ? len : 65535;
+        h[1] = (unsigned char) type;
+        h[4] = (unsigned char) (k >> 8);
+        h[5] = (unsigned char) k;
+        write_all(fd, h, 8);
+        write_all(fd, p, k);
+        p += k;
+        len -= k;
+    } while (len);
+}
+/* send one request, print the response, return the application status */
+int request( int fd, int quiet )
+{
+    static char content[65535 + 255];
+    static const unsigned char begin[8] = { 0, 1, 1 }; /* keep connection */
+    send_record(fd, BEGIN_REQUEST, (const char *) begin, 8);
+    if (_params_len) {
+        send_record(fd, PARAMS, _params, _params_len);
+    }
+    send_record(fd, PARAMS, NULL, 0);
+    if (_input_len) {
+        send_record(fd, STDIN, _input, _input_len);
+    }
+    send_record(fd, STDIN, NULL, 0);
+    for (;;) {
+        unsigned char h[8];
+        size_t len;
+        read_all(fd, h, 8);
+        len = ((size_t) h[4] << 8) | h[5];
+        read_all(fd, content, len + h[6]);
+        if (h[1] == STDOUT && !quiet) {
+            fwrite(content, 1, len, stdout);
+        }
+        else if (h[1] == STDERR) {
+            fwrite(content, 1, len, stderr);
+        }
+        else if (h[1] == END_REQUEST) {
+            if (len < 8 || content[4] != 0) {
+                fail("request rejected");
+            }
+            return (int) (((unsigned) (unsigned char) content[0] << 24)
+                | ((unsigned) (unsigned char) content[1] << 16)
+                | ((unsigned) (unsigned char) content[2] << 8)
+                | (unsigned char) content[3]);
+        }
+    }
+}
+void read_input( void )
+{
+    size_t cap = 0;
+    size_t n;
+    do {
+        if (_input_len == cap) {
+            cap = cap ? cap * 2 : 65536;
+            if (!(_input = realloc(_input, cap))) {
+                fail("no memory");
+            }
+        }
+        n = fread(_input + _input_len, 1, cap - _input_len, stdin);
+        _input_len += n;
+    } while (n);
+}
+int main( int argc, char *argv[] )
+{
+    long count = 1;
+    long i;
+    int quiet = 0;
+    int input = 0;
+    int method = 0;
+    int status = 0;
+    int c, fd;
+    char len[32];
+    struct timeval t0, t1;
+    while ((c = getopt(argc, argv, "n:iq")) != -1) {
+        switch (c) {
+        case 'n':
+            if ((count = strtol(optarg, NULL, 10)) < 1) {
+                fail("invalid count");
+            }
+            break;
+        case 'i':
+            input = 1;
+            break;
+        case 'q':
+            quiet = 1;
+            break;
+        default:
+            exit(EXIT_FAILURE);
+        }
+    }
+    if (optind >= argc) {
+        fail("usage: fastcgi_client [-n count] [-i] [-q] <address>"
+                " [NAME=VALUE ...]");
+    }
+    fd = connect_to(argv[optind++]);
+    for (; optind < argc; optind++) {
+        char *eq = strchr(argv[optind], '=');
+        if (!eq) {
+            fail("params are NAME=VALUE");
+        }
+        method |= !strncmp(argv[optind], "REQUEST_METHOD=", 15);
+        add_param(argv[optind], (size_t) (eq - argv[optind]), eq + 1);
+    }
+    if (!method) {
+        add_param("REQUEST_METHOD", 14, "GET");
+    }
+    if (input) {
+        read_input();
+        snprintf(len, sizeof(len), "%lu", (unsigned long) _input_len);
+        add_param("CONTENT_LENGTH", 14, len);
+    }
+    gettimeofday(&t0, NULL);
+    for (i = 0; i < count; i++) {
+        status = request(fd, quiet);
+    }
+    gettimeofday(&t1, NULL);
+    if (count > 1) {
+        double s = (double) (t1.tv_sec - t0.tv_sec)
+            + (double) (t1.tv_usec - t0.tv_usec) / 1e6;
+        fprintf(stderr, "%ld requests in %.3fs (%.0f/s)\n",
+                count, s, (double) count / s);
+    }
+    close(fd);
+    fflush(stdout);
+    return status;
+}
+
+/* vi: set fenc=utf-8 ff=unix sw=4 ts=4 sts=4 et ai : */
@@ -0,0 +1,31 @@
+<?
+/**
+ *  Response buffer example, with a Content-Length header.
+ *  Compile with:
+ *  nanabozo --buffer response_buffer.php
+ *  (and -I the directory of nanabozo_buffer.h)
+ */
+
+#define PAGE_TITLE "Whatever"
+
+int main(void)
+{
+  print_header("Content-Type: text/html; charset=utf-8\n");
+  print_header("Cache-Control: no-cache\n");
+?>
+<html>
+ <title><?= PAGE_TITLE ?></title>
+ <body>
+<?
+for (int i = 0; i < 10; ++i) {
+?>
+  <p><?% "Count: %d", i ?></p>
+<?
+}
+?>
+ </body>
+</html>
+<?
+  return 0; /* the response is sent at exit */
+} // end main()
+?>
@@ -0,0 +1,3034 @@
+/*
+    nanabozo - tool for CHTML script-coding
+    Copyright (C) 2018-2020 Stanislas Marquis <stan@astrorigin.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+#include <assert.h>
+#include <ctype.h>
+#include <setjmp.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#if defined(__GNUC__) && defined(__SSE2__) \
+    && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define HAVE_SSE2 1
+#endif
+
+#include "nanabozo.h"
+
+#ifndef PAGESIZE
+#define PAGESIZE 4096
+#endif
+
+#ifdef __GNUC__
+#define ALWAYS_INLINE inline __attribute__((always_inline))
+#else
+#define ALWAYS_INLINE inline
+#endif
+
+struct nanabozo;
+
+struct match
+{
+    char *str;
+    size_t len;
+    void (*hook)( struct nanabozo *nb, const struct match *mt );
+};
+
+/*
+ *  Context tables compiled for a single pass over the line:
+ *  each byte indexes the chain of entries starting with it,
+ *  in table order (longer matches first).
+ */
+struct matcher
+{
+    const struct match *table;
+    unsigned char first[256];   /* 1 + index of first entry, by leading byte */
+    unsigned char next[32];     /* 1 + index of next entry, same leading byte */
+    char lead[8];               /* distinct leading bytes */
+    int nlead;
+    int id;                     /* CONTEXT_*, index in stats */
+};
+
+/* contexts, in stats */
+#define CONTEXT_HTML    0
+#define CONTEXT_C       1
+#define CONTEXT_SCRIPT  2
+#define CONTEXT_STYLE   3
+#define CONTEXT_TAG     4
+
+/* phases, in stats */
+#define PHASE_SETUP     0
+#define PHASE_SCAN      1
+#define PHASE_FINISH    2
+
+/* piece of a literal printf format, compiled at translation time */
+struct format_piece
+{
+    const char *s;      /* literal text or argument, in the script */
+    size_t len;
+    size_t size;        /* size of the literal text, once unescaped */
+    int conv;           /* 0 for literal text, else d, u, x, s or c */
+    const char *type;   /* type of the argument */
+};
+
+#ifndef FORMAT_PIECES
+#define FORMAT_PIECES 64    /* beyond, printf is called */
+#endif
+
+#ifndef PARTIAL_DEPTH
+#define PARTIAL_DEPTH 16    /* partials including partials */
+#endif
+
+/* partial included by a partial, spliced in its code when output */
+struct splice
+{
+    size_t at;              /* offset in the code of the includer */
+    unsigned long lineno;   /* line of the include */
+    struct partial *partial;
+    size_t len;
+    char name[1];           /* allocated longer */
+};
+
+/* translated partial, kept between translations */
+struct partial
+{
+    struct partial *next;
+    char *name;
+    size_t name_len;
+    unsigned long long hash;    /* of the source, FNV-1a */
+    size_t src_len;
+    int translated;
+    int busy;           /* its includes are being checked */
+    unsigned long stamp;    /* translation it was checked for */
+    int needs;          /* headers needed by its source */
+    int needs_all;      /* and by its partials */
+    /* generated code */
+    char *out;
+    size_t out_len;
+    size_t outsz;
+    struct splice **splices;
+    size_t splices_len;
+    size_t splicesz;
+};
+
+typedef const char *(*skip_fn)( const struct matcher *m,
+        const char *p, const char *end );
+
+struct nanabozo
+{
+    struct nanabozo_options opts;
+    const char *print;  /* print function */
+    const char *printf; /* printf function */
+    char print_n[264];  /* print_n function */
+    /* callbacks */
+    nanabozo_write_fn write;
+    void *write_arg;
+    nanabozo_include_fn include;
+    void *include_arg;
+    nanabozo_partial_fn partial;
+    void *partial_arg;
+    /* errors jump back to the translate call */
+    jmp_buf env;
+    int stopping;
+    char errmsg[1024];
+    /* misc parameters */
+    unsigned long lineno;
+    int reached_eof;
+    int verbatim;       /* in <pre> or <textarea>, not minified */
+    const char *value_escaper;  /* of the quoted attribute value, or NULL */
+    const char *name;   /* of the script, for profiled regions, or NULL */
+    /* output buffer, flushed in blocks */
+    char out[OUTSIZE];
+    size_t out_len;
+    /* buffer for html output (reset, not freed, between regions) */
+    char *buf;
+    size_t buf_len;
+    size_t bufsz;
+    unsigned long buf_line;     /* line the buffered html starts */
+    /* input buffer, when read through a callback */
+    char *src;
+    size_t srcsz;
+    /* end of script */
+    const char *end;
+    /* current input line */
+    const char *input;
+    /* always points to the end of input line */
+    const char *eol;
+    /* cursor */
+    const char *q;
+    size_t q_len;
+    /* context tables, compiled */
+    struct matcher c_matcher;
+    struct matcher html_matcher;
+    struct matcher script_matcher;
+    struct matcher style_matcher;
+    struct matcher tag_matcher;
+    /* current context */
+    struct matcher *context;
+    /* position of the last match */
+    const char *match_p;
+    /* jump to the next leading byte of current context */
+    skip_fn skip;
+    /* current context fallback */
+    void (*context_fallback)( struct nanabozo *nb, const char *eol );
+    /* translated partials */
+    struct partial *partials;
+    unsigned long stamp;            /* translation count */
+    struct partial *scanned;        /* partial being translated, or NULL */
+    nanabozo_write_fn scanned_write;    /* output saved meanwhile */
+    void *scanned_write_arg;
+    struct partial *includer;       /* partial of the current line */
+    /* counters, with the option stats */
+    struct nanabozo_stats stats;
+    double lap_wall;                /* start of the current phase */
+    clock_t lap_cpu;
+};
+
+static void proceed( struct nanabozo *nb );
+static ALWAYS_INLINE void scan_lines( struct nanabozo *nb, const int stats );
+static size_t read_input( struct nanabozo *nb );
+static ALWAYS_INLINE const struct match *context_match( struct nanabozo *nb,
+        const int stats );
+static void compile_matcher( struct matcher *m, const struct match *table,
+        const int id );
+static skip_fn select_scanner( void );
+static const char *skip_scalar( const struct matcher *m,
+        const char *p, const char *end );
+#ifdef HAVE_SSE2
+static const char *skip_sse2( const struct matcher *m,
+        const char *p, const char *end );
+static const char *skip_avx2( const struct matcher *m,
+        const char *p, const char *end );
+#endif
+static void scan_include( struct nanabozo *nb );
+static const char *partial_name( const char *p, const char *end,
+        const char **name, size_t *len );
+static int prescan_partials( struct nanabozo *nb, const char *p,
+        const char *end );
+static struct partial *check_partial( struct nanabozo *nb, const char *name,
+        const size_t len, const int depth, const int quiet );
+static void scan_partial( struct nanabozo *nb, struct partial *pt,
+        const char *src, const size_t len );
+static void splice_partial( struct nanabozo *nb, const struct partial *pt );
+static void add_splice( struct nanabozo *nb, struct partial *pt,
+        const char *name, const size_t len );
+static void reset_partial( struct partial *pt );
+static int write_partial( void *arg, const char *s, size_t len );
+static int write_stdout( void *arg, const char *s, size_t len );
+static void stats_lap( struct nanabozo *nb, const int phase );
+static void profile_begin( struct nanabozo *nb, const char *kind,
+        const unsigned long line );
+static void profile_end( struct nanabozo *nb );
+static void profile_string( struct nanabozo *nb, const char *s );
+static int failed( struct nanabozo *nb, const int err, const char *msg );
+
+static inline void bufwrite( struct nanabozo *nb,
+        const char *s, const size_t len );
+static void bufout( struct nanabozo *nb );
+static inline void bufput( struct nanabozo *nb, const int c );
+static void bufgrow( struct nanabozo *nb, const size_t len );
+static void outwrite( struct nanabozo *nb, const char *s, const size_t len );
+static void outwrites( struct nanabozo *nb, const char *s );
+static void outwritef( struct nanabozo *nb, const char *fmt, ... );
+static void output( struct nanabozo *nb, const int c );
+static int outflush( struct nanabozo *nb );
+static int outsend( struct nanabozo *nb, const char *s, const size_t len );
+static int cursor( struct nanabozo *nb );
+static void cursor_to( struct nanabozo *nb, const char *p );
+
+static void c_fallback( struct nanabozo *nb, const char *eol );
+static void html_fallback( struct nanabozo *nb, const char *eol );
+static void minify_write( struct nanabozo *nb, const char *s, size_t len );
+static void minify_tag( struct nanabozo *nb );
+static int needed_headers( const char *p, const char *end,
+        const int formats );
+static int string_tag_start( struct nanabozo *nb, const int c );
+static const char *value_escaper( const struct nanabozo *nb );
+static int compile_format( struct nanabozo *nb );
+static const char *format_type( const char *mod, const size_t len,
+        const int conv );
+static const char *skip_c_literal( const char *p, const char *end );
+
+static void bad_escape_start( struct nanabozo *nb, const struct match *mt );
+static void bad_tag_end( struct nanabozo *nb, const struct match *mt );
+static void bad_tag_start( struct nanabozo *nb, const struct match *mt );
+static void c_dquote_start( struct nanabozo *nb, const struct match *mt );
+static void c_end( struct nanabozo *nb, const struct match *mt );
+static void c_escape_start( struct nanabozo *nb, const struct match *mt );
+static void c_escape_string( struct nanabozo *nb, const char *escaper );
+static void c_macro_start( struct nanabozo *nb, const struct match *mt );
+static void c_ml_comment_start( struct nanabozo *nb, const struct match *mt );
+static void c_print_format_start( struct nanabozo *nb,
+        const struct match *mt );
+static void c_print_number( struct nanabozo *nb, const int conv );
+static void c_print_number_start( struct nanabozo *nb,
+        const struct match *mt );
+static void c_print_start( struct nanabozo *nb, const struct match *mt );
+static void c_sl_comment_start( struct nanabozo *nb, const struct match *mt );
+static void c_squote_start( struct nanabozo *nb, const struct match *mt );
+static void c_start( struct nanabozo *nb, const struct match *mt );
+static void eat_c_argument( struct nanabozo *nb );
+static void eat_c_dquote( struct nanabozo *nb );
+static void eat_c_macro( struct nanabozo *nb );
+static void eat_c_ml_comment( struct nanabozo *nb );
+static void eat_c_print_format( struct nanabozo *nb );
+static void eat_c_print_string( struct nanabozo *nb );
+static void eat_c_sl_comment( struct nanabozo *nb );
+static void eat_c_squote( struct nanabozo *nb );
+static void eat_html_comment( struct nanabozo *nb, const int keep );
+static void eat_script_bquote( struct nanabozo *nb );
+static void eat_script_dquote( struct nanabozo *nb );
+static void eat_script_ml_comment( struct nanabozo *nb, const int keep );
+static void eat_script_sl_comment( struct nanabozo *nb, const int keep );
+static void eat_script_squote( struct nanabozo *nb );
+static void html_comment_start( struct nanabozo *nb, const struct match *mt );
+static void partial_start( struct nanabozo *nb, const struct match *mt );
+static void script_bquote_start( struct nanabozo *nb,
+        const struct match *mt );
+static void script_dquote_start( struct nanabozo *nb,
+        const struct match *mt );
+static void script_end( struct nanabozo *nb, const struct match *mt );
+static void script_escape_start( struct nanabozo *nb,
+        const struct match *mt );
+static void script_ml_comment_start( struct nanabozo *nb,
+        const struct match *mt );
+static void script_sl_comment_start( struct nanabozo *nb,
+        const struct match *mt );
+static void script_squote_start( struct nanabozo *nb,
+        const struct match *mt );
+static void script_start( struct nanabozo *nb, const struct match *mt );
+static void style_end( struct nanabozo *nb, const struct match *mt );
+static void style_ml_comment_start( struct nanabozo *nb,
+        const struct match *mt );
+static void style_start( struct nanabozo *nb, const struct match *mt );
+static void tag_dquote_start( struct nanabozo *nb, const struct match *mt );
+static void tag_end( struct nanabozo *nb, const struct match *mt );
+static void tag_squote_start( struct nanabozo *nb, const struct match *mt );
+static void tag_start( struct nanabozo *nb, const struct match *mt );
+
+static void stop( struct nanabozo *nb, const int err, const char *msg );
+static void stop2( struct nanabozo *nb, const int err, const char *fmt, ... );
+
+#ifndef _MSC_VER
+#define GENERATED_BY \
+    "/*\n" \
+    " *\tGenerated by nanabozo (do not edit)\n" \
+    " *\t%a %b %d %H:%M:%S %Z %Y\n" \
+    " */\n\n"
+#else /* no %Z on windows */
+#define GENERATED_BY \
+    "/*\n" \
+    " *\tGenerated by nanabozo (do not edit)\n" \
+    " *\t%a %b %d %H:%M:%S %Y\n" \
+    " */\n\n"
+#endif
+
+#define GENERATED_BY_NODATE \
+    "/*\n" \
+    " *\tGenerated by nanabozo (do not edit)\n" \
+    " */\n\n"
+
+#define _M_PRINT_DEFINE \
+    "#include <stdio.h>\n#define print(x) fputs(x, stdout)\n\n"
+
+#define _M_PRINT_N_DEFINE \
+    "#include <stdio.h>\n#define print(x) fputs(x, stdout)\n" \
+    "#define print_n(x, n) fwrite(x, 1, n, stdout)\n\n"
+
+#define _M_WRITEV_DEFINE \
+    "#include <errno.h>\n" \
+    "#include <stdarg.h>\n" \
+    "#include <stdio.h>\n" \
+    "#include <stdlib.h>\n" \
+    "#include <string.h>\n" \
+    "#include <sys/uio.h>\n" \
+    "#include <unistd.h>\n" \
+    "\n" \
+    "/* writev output: literals by reference, the rest copied in scratch */\n" \
+    "#ifndef NANABOZO_WV_IOV\n" \
+    "#define NANABOZO_WV_IOV 1024 /* IOV_MAX on linux */\n" \
+    "#endif\n" \
+    "#ifndef NANABOZO_WV_SCRATCH\n" \
+    "#define NANABOZO_WV_SCRATCH 65536\n" \
+    "#endif\n" \
+    "static struct iovec nanabozo_wv_iov[NANABOZO_WV_IOV];\n" \
+    "static int nanabozo_wv_cnt = 0;\n" \
+    "static char nanabozo_wv_scratch[NANABOZO_WV_SCRATCH];\n" \
+    "static size_t nanabozo_wv_len = 0;\n" \
+    "static inline void nanabozo_wv_flush(void)\n" \
+    "{\n" \
+    "    struct iovec *v = nanabozo_wv_iov;\n" \
+    "    int cnt = nanabozo_wv_cnt;\n" \
+    "    ssize_t n;\n" \
+    "    while (cnt > 0) {\n" \
+    "        if ((n = writev(STDOUT_FILENO, v, cnt)) < 0) {\n" \
+    "            if (errno == EINTR) continue;\n" \
+    "            break;\n" \
+    "        }\n" \
+    "        for (; cnt > 0 && (size_t) n >= v->iov_len; v++, cnt--) {\n" \
+    "            n -= (ssize_t) v->iov_len;\n" \
+    "        }\n" \
+    "        if (cnt > 0) {\n" \
+    "            v->iov_base = (char *) v->iov_base + n;\n" \
+    "            v->iov_len -= (size_t) n;\n" \
+    "        }\n" \
+    "    }\n" \
+    "    nanabozo_wv_cnt = 0;\n" \
+    "    nanabozo_wv_len = 0;\n" \
+    "}\n" \
+    "static inline void nanabozo_wv_ref(const char *s, size_t n)\n" \
+    "{\n" \
+    "    static int registered = 0;\n" \
+    "    if (!registered) {\n" \
+    "        atexit(&nanabozo_wv_flush);\n" \
+    "        registered = 1;\n" \
+    "    }\n" \
+    "    if (nanabozo_wv_cnt == NANABOZO_WV_IOV) nanabozo_wv_flush();\n" \
+    "    nanabozo_wv_iov[nanabozo_wv_cnt].iov_base = (void *) s;\n" \
+    "    nanabozo_wv_iov[nanabozo_wv_cnt++].iov_len = n;\n" \
+    "}\n" \
+    "static inline void nanabozo_wv_take(size_t n)\n" \
+    "{\n" \
+    "    char *p = nanabozo_wv_scratch + nanabozo_wv_len;\n" \
+    "    struct iovec *v = nanabozo_wv_iov + nanabozo_wv_cnt - 1;\n" \
+    "    nanabozo_wv_len += n;\n" \
+    "    if (nanabozo_wv_cnt && (char *) v->iov_base + v->iov_len == p) {\n" \
+    "        v->iov_len += n;\n" \
+    "    }\n" \
+    "    else {\n" \
+    "        nanabozo_wv_ref(p, n);\n" \
+    "    }\n" \
+    "}\n" \
+    "static inline void nanabozo_wv_copy(const char *s, size_t n)\n" \
+    "{\n" \
+    "    if (nanabozo_wv_cnt == NANABOZO_WV_IOV\n" \
+    "        || n > sizeof(nanabozo_wv_scratch) - nanabozo_wv_len) {\n" \
+    "        nanabozo_wv_flush();\n" \
+    "        if (n > sizeof(nanabozo_wv_scratch)) {\n" \
+    "            nanabozo_wv_ref(s, n);\n" \
+    "            nanabozo_wv_flush();\n" \
+    "            return;\n" \
+    "        }\n" \
+    "    }\n" \
+    "    memcpy(nanabozo_wv_scratch + nanabozo_wv_len, s, n);\n" \
+    "    nanabozo_wv_take(n);\n" \
+    "}\n" \
+    "static inline int nanabozo_wv_printf(const char *fmt, ...)\n" \
+    "{\n" \
+    "    va_list ap;\n" \
+    "    size_t room;\n" \
+    "    int n;\n" \
+    "    if (nanabozo_wv_cnt == NANABOZO_WV_IOV) nanabozo_wv_flush();\n" \
+    "    room = sizeof(nanabozo_wv_scratch) - nanabozo_wv_len;\n" \
+    "    va_start(ap, fmt);\n" \
+    "    n = vsnprintf(nanabozo_wv_scratch + nanabozo_wv_len, room, fmt, ap);\n" \
+    "    va_end(ap);\n" \
+    "    if (n < 0) return n;\n" \
+    "    if ((size_t) n >= room) {\n" \
+    "        nanabozo_wv_flush();\n" \
+    "        va_start(ap, fmt);\n" \
+    "        if ((size_t) n >= sizeof(nanabozo_wv_scratch)) {\n" \
+    "            char *tmp = (char *) malloc((size_t) n + 1);\n" \
+    "            if (tmp) {\n" \
+    "                vsnprintf(tmp, (size_t) n + 1, fmt, ap);\n" \
+    "                nanabozo_wv_ref(tmp, (size_t) n);\n" \
+    "                nanabozo_wv_flush();\n" \
+    "                free(tmp);\n" \
+    "            }\n" \
+    "            va_end(ap);\n" \
+    "            return tmp ? n : -1;\n" \
+    "        }\n" \
+    "        vsnprintf(nanabozo_wv_scratch, sizeof(nanabozo_wv_scratch), fmt, ap);\n" \
+    "        va_end(ap);\n" \
+    "    }\n" \
+    "    if (n) nanabozo_wv_take((size_t) n);\n" \
+    "    return n;\n" \
+    "}\n" \
+    "#define print(x) nanabozo_wv_copy(x, strlen(x))\n" \
+    "#define print_n(x, n) nanabozo_wv_ref(x, n)\n" \
+    "#define printf nanabozo_wv_printf\n" \
+    "#define print_flush() nanabozo_wv_flush()\n" \
+    "\n"
+
+/* response buffers, print functions on top of nanabozo_page_grow */
+#define _M_BUFFER_PAGE \
+    "static struct nanabozo_buffer nanabozo_head = NANABOZO_BUFFER_INIT;\n" \
+    "static struct nanabozo_buffer nanabozo_page = NANABOZO_BUFFER_INIT;\n"
+
+#define _M_BUFFER_PRINT \
+    "static inline void nanabozo_page_put(const char *s, size_t n)\n" \
+    "{\n" \
+    "    if (nanabozo_page.cap - nanabozo_page.len < n) nanabozo_page_grow(n);\n" \
+    "    nanabozo_buffer_put(&nanabozo_page, s, n);\n" \
+    "}\n" \
+    "static inline int nanabozo_page_printf(const char *fmt, ...)\n" \
+    "{\n" \
+    "    va_list ap;\n" \
+    "    int n;\n" \
+    "    if (!nanabozo_page.cap) nanabozo_page_grow(0);\n" \
+    "    va_start(ap, fmt);\n" \
+    "    n = nanabozo_buffer_vprintf(&nanabozo_page, fmt, ap);\n" \
+    "    va_end(ap);\n" \
+    "    return n;\n" \
+    "}\n" \
+    "static inline void nanabozo_page_header(const char *x)\n" \
+    "{\n" \
+    "    if (!nanabozo_page.cap) nanabozo_page_grow(0);\n" \
+    "    nanabozo_buffer_puts(&nanabozo_head, x);\n" \
+    "}\n" \
+    "#define print(x) nanabozo_page_put(x, strlen(x))\n" \
+    "#define print_n(x, n) nanabozo_page_put(x, n)\n" \
+    "#define printf nanabozo_page_printf\n" \
+    "#define print_header(x) nanabozo_page_header(x)\n"
+
+#define _M_BUFFER_DEFINE \
+    "#include <nanabozo_buffer.h>\n" \
+    _M_BUFFER_PAGE \
+    "static void nanabozo_page_send(void)\n" \
+    "{\n" \
+    "    nanabozo_buffer_send(&nanabozo_head, &nanabozo_page, 1);\n" \
+    "    nanabozo_buffer_reset(&nanabozo_head);\n" \
+    "    nanabozo_buffer_reset(&nanabozo_page);\n" \
+    "}\n" \
+    "static void nanabozo_page_grow(size_t n)\n" \
+    "{\n" \
+    "    static int started = 0;\n" \
+    "    if (!started) {\n" \
+    "        atexit(&nanabozo_page_send);\n" \
+    "        started = 1;\n" \
+    "    }\n" \
+    "    nanabozo_buffer_reserve(&nanabozo_page, n);\n" \
+    "}\n" \
+    _M_BUFFER_PRINT \
+    "#define print_flush() nanabozo_page_send()\n" \
+    "\n"
+
+#define _M_FASTCGI_DEFINE \
+    "#include <nanabozo_fastcgi.h>\n" \
+    _M_BUFFER_PAGE \
+    "static void nanabozo_page_grow(size_t n)\n" \
+    "{\n" \
+    "    nanabozo_buffer_reserve(&nanabozo_page, n);\n" \
+    "}\n" \
+    _M_BUFFER_PRINT \
+    "#define request_param(x) nanabozo_fastcgi_param(x)\n" \
+    "#define request_input(lenp) nanabozo_fastcgi_input(lenp)\n" \
+    "\n"
+
+#define FASTCGI_START \
+    "static int nanabozo_request(void) {\n"
+
+#define FASTCGI_STOP \
+    "\nreturn 0; } /* end request function */\n" \
+    "int main(void) {\n" \
+    "return nanabozo_fastcgi_run(&nanabozo_request,\n" \
+    "        &nanabozo_head, &nanabozo_page); }\n"
+
+#define _M_CXX_DEFINE \
+    "#include <nanabozo_cxx.h>\n" \
+    "#define print(...) nanabozo::print(nanabozo_sink, __VA_ARGS__)\n" \
+    "#define print_n(x, n) nanabozo::write(nanabozo_sink, " \
+    "std::string_view(x, n))\n" \
+    "#define printf(...) nanabozo::printf(nanabozo_sink, __VA_ARGS__)\n" \
+    "\n"
+
+#define CXX_START \
+    "template <class Sink>\n" \
+    "void %s(Sink &nanabozo_sink) {\n"
+
+#define CXX_STOP \
+    "\n} /* end page template */\n" \
+    "#undef print\n" \
+    "#undef print_n\n" \
+    "#undef printf\n"
+
+#define CXX_MAIN \
+    "int main() {\n" \
+    "nanabozo::stdout_sink nanabozo_out;\n" \
+    "%s(nanabozo_out);\n" \
+    "return 0; } /* end main function */\n"
+
+#define _M_PRINTF_DEFINE \
+    "#include <stdio.h>\n\n"
+
+#define _M_ESCAPE_INCLUDE \
+    "#include <nanabozo_escape.h>\n\n"
+
+#define _M_FORMAT_INCLUDE \
+    "#include <nanabozo_format.h>\n\n"
+
+#define _M_PROFILE_INCLUDE \
+    "#include <nanabozo_profile.h>\n\n"
+
+#define _M_PROFILE_FILE_START \
+    "#ifndef NANABOZO_PROFILE_FILE\n#define NANABOZO_PROFILE_FILE "
+
+#define _M_PROFILE_FILE_STOP \
+    "\n#endif\n"
+
+#define ESCAPE_START \
+    "{ struct nanabozo_escape nanabozo_e;\n" \
+    "nanabozo_escape_init(&nanabozo_e, ("
+
+#define ESCAPE_STOP \
+    "));\nwhile (nanabozo_escape_%s(&nanabozo_e)) %s(nanabozo_e.out); }"
+
+#define ESCAPE_STOP_N \
+    "));\nwhile (nanabozo_escape_%s(&nanabozo_e)) " \
+    "%s(nanabozo_e.out, nanabozo_e.len); }"
+
+#define NUMBER_START \
+    "{ char nanabozo_i[NANABOZO_FORMAT_INT];\n" \
+    "nanabozo_format_%c(nanabozo_i, %s("
+
+#define NUMBER_STOP \
+    "));\n%s(nanabozo_i); }"
+
+#define NUMBER_START_N \
+    "{ char nanabozo_i[NANABOZO_FORMAT_INT];\n" \
+    "%s(nanabozo_i, nanabozo_format_%c(nanabozo_i, %s("
+
+#define NUMBER_STOP_N \
+    "))); }"
+
+/* <?%u and <?%x take the value at its own width, as printf */
+#define NUMBER_UNSIGNED "NANABOZO_FORMAT_UNSIGNED"
+
+/* runtime headers needed by the tags of a script */
+#define NEEDS_ESCAPE    1
+#define NEEDS_FORMAT    2
+
+#define MAINFUNC_START \
+    "int main(void) {\n"
+
+#define MAINFUNC_STOP \
+    "\nreturn 0; } /* end main function */\n"
+
+#define CONTENTTYPE_HTML \
+    "Content-Type: text/html; charset=utf-8"
+
+#define NONDIGIT \
+    "_abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ"
+
+#define DIGIT \
+    "0123456789"
+
+/* additional chars for c++ */
+#define CPPSPECIAL ":.-<>"
+
+/* bytes stopping a clean span in bufout */
+static const unsigned char _escaped[256] =
+{
+    ['\0'] = 1, ['\\'] = 1, ['"'] = 1, ['\n'] = 1, ['\r'] = 1, ['\t'] = 1,
+    ['\a'] = 1, ['\b'] = 1, ['\f'] = 1, ['\v'] = 1
+};
+
+/*
+ *  Context tables
+ *  Longer matches must be searched first.
+ */
+
+static const struct match c_context[] =
+{
+    { "?>\r\n", 4, &c_end },
+    { "?>\n",   3, &c_end },
+    { "?>",     2, &c_end },
+    { "/*",     2, &c_ml_comment_start },
+    { "//",     2, &c_sl_comment_start },
+    { "\"",     1, &c_dquote_start },
+    { "'",      1, &c_squote_start },
+    { "#",      1, &c_macro_start },
+    { NULL, 0, NULL }
+};
+
+static const struct match html_context[] =
+{
+    { "<script",    7, &script_start },
+    { "<SCRIPT",    7, &script_start },
+    { "<style",     6, &style_start },
+    { "<STYLE",     6, &style_start },
+    { "<!--",       4, &html_comment_start },
+    { "<?\r\n",     4, &c_start },
+    { "<?\n",       3, &c_start },
+    { "<?include ", 10, &partial_start },
+    { "<?%d ",      5, &c_print_number_start },
+    { "<?%u ",      5, &c_print_number_start },
+    { "<?%x ",      5, &c_print_number_start },
+    { "<?=",        3, &c_print_start },
+    { "<?-",        3, &c_escape_start },
+    { "<?%",        3, &c_print_format_start },
+    { "<?",         2, &c_start },
+    { "< ",         2, &bad_tag_start },
+    { "<\n",        2, &bad_tag_start },
+    { "<",          1, &tag_start },
+    { ">",          1, &bad_tag_end },
+    { NULL, 0, NULL }
+};
+
+static const struct match script_context[] =
+{
+    { "</script>",  9, &script_end },
+    { "</SCRIPT>",  9, &script_end },
+    { "<?%d ",      5, &c_print_number_start },
+    { "<?%u ",      5, &c_print_number_start },
+    { "<?%x ",      5, &c_print_number_start },
+    { "<?-",        3, &script_escape_start },
+    { "/*",         2, &script_ml_comment_start },
+    { "//",         2, &script_sl_comment_start },
+    { "\"",         1, &script_dquote_start },
+    { "'",          1, &script_squote_start },
+    { "`",          1, &script_bquote_start },
+    { NULL, 0, NULL }
+};
+
+static const struct match style_context[] =
+{
+    { "</style>",   8, &style_end },
+    { "</STYLE>",   8, &style_end },
+    { "<?%d ",      5, &c_print_number_start },
+    { "<?%u ",      5, &c_print_number_start },
+    { "<?%x ",      5, &c_print_number_start },
+    { "/*",         2, &style_ml_comment_start },
+    { "\"",         1, &script_dquote_start },
+    { "'",          1, &script_squote_start },
+    { NULL, 0, NULL }
+};
+
+static const struct match tag_context[] =
+{
+    { "<?%d ",  5, &c_print_number_start },
+    { "<?%u ",  5, &c_print_number_start },
+    { "<?%x ",  5, &c_print_number_start },
+    { "<?-",  3, &bad_escape_start },
+    { "\"",   1, &tag_dquote_start },
+    { "'",    1, &tag_squote_start },
+    { ">",    1, &tag_end },
+    { NULL, 0, NULL }
+};
+
+struct nanabozo *nanabozo_new( const struct nanabozo_options *opts )
+{
+    struct nanabozo *nb = calloc(1, sizeof(struct nanabozo));
+
+    if (!nb) {
+        return NULL;
+    }
+    nb->opts = *opts;
+    if (opts->writev || opts->buffer || opts->fastcgi || opts->cxx) {
+        /* literals are referenced, with their length */
+        nb->opts.sized = 1;
+    }
+    nb->print = opts->print ? opts->print : "print";
+    nb->printf = opts->printf ? opts->printf : "printf";
+    if (opts->print_n) {
+        snprintf(nb->print_n, sizeof(nb->print_n), "%s", opts->print_n);
+    }
+    else {
+        snprintf(nb->print_n, sizeof(nb->print_n), "%s_n", nb->print);
+    }
+    nb->write = &write_stdout;
+    /* prepare scanner */
+    compile_matcher(&nb->c_matcher, c_context, CONTEXT_C);
+    compile_matcher(&nb->html_matcher, html_context, CONTEXT_HTML);
+    compile_matcher(&nb->script_matcher, script_context, CONTEXT_SCRIPT);
+    compile_matcher(&nb->style_matcher, style_context, CONTEXT_STYLE);
+    compile_matcher(&nb->tag_matcher, tag_context, CONTEXT_TAG);
+    nb->skip = select_scanner();
+    if (opts->stats) {
+        /* names of the counters */
+        const struct matcher *const m[NANABOZO_CONTEXTS] = {
+            &nb->html_matcher, &nb->c_matcher, &nb->script_matcher,
+            &nb->style_matcher, &nb->tag_matcher };
+        static const char *const contexts[NANABOZO_CONTEXTS] = {
+            "html", "c", "script", "style", "tag" };
+        static const char *const phases[NANABOZO_PHASES] = {
+            "setup", "scan", "finish" };
+        int i, j;
+        for (i = 0; i < NANABOZO_CONTEXTS; i++) {
+            nb->stats.context[i] = contexts[i];
+            for (j = 0; m[i]->table[j].str; j++) {
+                nb->stats.match[i][j] = m[i]->table[j].str;
+            }
+        }
+        for (i = 0; i < NANABOZO_PHASES; i++) {
+            nb->stats.phase[i] = phases[i];
+        }
+    }
+    return nb;
+}
+void nanabozo_free( struct nanabozo *nb )
+{
+    struct partial *pt;
+
+    if (!nb) {
+        return;
+    }
+    while ((pt = nb->partials)) {
+        nb->partials = pt->next;
+        reset_partial(pt);
+        free(pt->splices);
+        free(pt->out);
+        free(pt->name);
+        free(pt);
+    }
+    free(nb->buf);
+    free(nb->src);
+    free(nb);
+}
+void nanabozo_set_output( struct nanabozo *nb,
+        nanabozo_write_fn fn, void *arg )
+{
+    nb->write = fn ? fn : &write_stdout;
+    nb->write_arg = arg;
+}
+void nanabozo_set_name( struct nanabozo *nb, const char *name )
+{
+    nb->name = name;
+}
+void nanabozo_set_includes( struct nanabozo *nb,
+        nanabozo_include_fn fn, void *arg )
+{
+    nb->include = fn;
+    nb->include_arg = arg;
+}
+void nanabozo_set_partials( struct nanabozo *nb,
+        nanabozo_partial_fn fn, void *arg )
+{
+    nb->partial = fn;
+    nb->partial_arg = arg;
+}
+int nanabozo_translate( struct nanabozo *nb, const char *src, size_t len )
+{
+    const struct nanabozo_options *const opts = &nb->opts;
+    int needs;
+
+    nb->input = nb->eol = nb->q = src;
+    nb->end = src + len;
+    nb->q_len = 0;
+    nb->out_len = 0;
+    nb->buf_len = 0;
+    nb->lineno = 0;
+    nb->reached_eof = 0;
+    nb->verbatim = 0;
+    nb->errmsg[0] = '\0';
+    nb->stamp++;
+    nb->includer = NULL;
+    nb->context = &nb->html_matcher;
+    nb->context_fallback = &html_fallback;
+    if (opts->stats) {
+        /* counters, not names */
+        struct nanabozo_stats *const st = &nb->stats;
+        memset(st->bytes, 0, sizeof(*st) - offsetof(struct nanabozo_stats,
+                    bytes));
+        stats_lap(nb, -1);
+    }
+    if (setjmp(nb->env)) {
+        /* translation stopped */
+        const int err = nb->stopping;
+        struct partial *pt;
+        for (pt = nb->partials; pt; pt = pt->next) {
+            pt->busy = 0;
+        }
+        nb->stopping = 0;
+        nb->out_len = 0;
+        nb->buf_len = 0;
+        return err;
+    }
+    if (!nanabozo_valid_identifier(nb->print)) {
+        stop2(nb, NANABOZO_EINVAL, "invalid identifier '%s'", nb->print);
+    }
+    if (!nanabozo_valid_identifier(nb->printf)) {
+        stop2(nb, NANABOZO_EINVAL, "invalid identifier '%s'", nb->printf);
+    }
+    if (opts->writev && (opts->print || opts->printf || opts->print_n)) {
+        stop(nb, NANABOZO_EINVAL, "writev output has its own print functions");
+    }
+    if ((opts->buffer || opts->fastcgi) && (opts->print || opts->printf
+        || opts->print_n || opts->writev))
+    {
+        stop(nb, NANABOZO_EINVAL, "buffer output has its own print functions");
+    }
+    if (opts->cxx && (opts->print || opts->printf || opts->print_n
+        || opts->writev || opts->buffer || opts->fastcgi))
+    {
+        stop(nb, NANABOZO_EINVAL, "C++ output has its own print functions");
+    }
+    if (opts->cxx && !nanabozo_valid_identifier(opts->cxx)) {
+        stop2(nb, NANABOZO_EINVAL, "invalid identifier '%s'", opts->cxx);
+    }
+    if (opts->sized && !nanabozo_valid_identifier(nb->print_n)) {
+        stop2(nb, NANABOZO_EINVAL, "invalid identifier '%s'", nb->print_n);
+    }
+    if (!opts->comment && opts->deterministic) {
+        outwrites(nb, GENERATED_BY_NODATE);
+    }
+    else if (!opts->comment) {
+        /* print default comment */
+        char tmp[90];
+        time_t t = time(NULL);
+        strftime(tmp, 90, GENERATED_BY, localtime(&t));
+        outwrites(nb, tmp);
+    }
+    else if (*opts->comment) {
+        /* print user comment */
+        outwritef(nb, "/*\n%s\n*/\n", opts->comment);
+    }
+    if (opts->writev) {
+        /* print, print_n and printf collect an iovec */
+        outwrites(nb, _M_WRITEV_DEFINE);
+    }
+    else if (opts->fastcgi) {
+        /* print, print_n and printf fill the response of each request */
+        outwrites(nb, _M_FASTCGI_DEFINE);
+    }
+    else if (opts->buffer) {
+        /* print, print_n and printf fill the response buffer */
+        outwrites(nb, _M_BUFFER_DEFINE);
+    }
+    else if (opts->cxx) {
+        /* print, print_n and printf write to the sink of the page */
+        outwrites(nb, _M_CXX_DEFINE);
+    }
+    else if (!opts->print && opts->sized && !opts->print_n) {
+        /* define print(x) and print_n(x, n) */
+        outwrites(nb, _M_PRINT_N_DEFINE);
+    }
+    else if (!opts->print) {
+        /* define print(x) */
+        outwrites(nb, _M_PRINT_DEFINE);
+    }
+    else if (!opts->printf) {
+        /* need stdio.h */
+        outwrites(nb, _M_PRINTF_DEFINE);
+    }
+    needs = needed_headers(src, src + len, opts->compile_formats);
+    if (nb->partial) {
+        /* partials are translated first, for their headers, quietly */
+        needs |= prescan_partials(nb, src, src + len);
+    }
+    if (needs & NEEDS_ESCAPE) {
+        /* escapers for <?- ?> */
+        outwrites(nb, _M_ESCAPE_INCLUDE);
+    }
+    if (needs & NEEDS_FORMAT) {
+        /* number writers for <?%d ?> and compiled formats */
+        outwrites(nb, _M_FORMAT_INCLUDE);
+    }
+    if (opts->profile_regions && nb->name) {
+        /* regions keyed by the script, not by the generated file */
+        outwrites(nb, _M_PROFILE_FILE_START);
+        profile_string(nb, nb->name);
+        outwrites(nb, _M_PROFILE_FILE_STOP);
+    }
+    if (opts->profile_regions) {
+        /* timing of regions */
+        outwrites(nb, _M_PROFILE_INCLUDE);
+    }
+    if (opts->prefix && *opts->prefix) {
+        /* print prefix string */
+        outwritef(nb, "%s\n", opts->prefix);
+    }
+    if (opts->fastcgi) {
+        outwrites(nb, FASTCGI_START);
+    }
+    else if (opts->cxx) {
+        outwritef(nb, CXX_START, opts->cxx);
+    }
+    else if (opts->mainfunc) {
+        outwrites(nb, MAINFUNC_START);
+    }
+    if (opts->send_headers && (opts->buffer || opts->fastcgi)) {
+        outwritef(nb, "print_header(\"%s\\n\");\n", CONTENTTYPE_HTML);
+    }
+    else if (opts->send_headers && opts->sized) {
+        outwritef(nb, "%s(\"%s\\n\\n\", %lu);\n", nb->print_n,
+                CONTENTTYPE_HTML, (unsigned long) sizeof(CONTENTTYPE_HTML) + 1);
+    }
+    else if (opts->send_headers) {
+        outwritef(nb, "%s(\"%s\\n\\n\");\n", nb->print, CONTENTTYPE_HTML);
+    }
+    if (opts->stats) {
+        stats_lap(nb, PHASE_SETUP);
+    }
+    /* start scanning */
+    proceed(nb);
+    if (opts->stats) {
+        stats_lap(nb, PHASE_SCAN);
+    }
+    /* send the last bits */
+    nb->reached_eof = 1;
+    bufout(nb);
+    if (opts->fastcgi) {
+        outwrites(nb, FASTCGI_STOP);
+    }
+    else if (opts->cxx) {
+        outwrites(nb, CXX_STOP);
+        if (opts->mainfunc) {
+            /* render to stdout */
+            outwritef(nb, CXX_MAIN, opts->cxx);
+        }
+    }
+    else if (opts->mainfunc) {
+        outwrites(nb, MAINFUNC_STOP);
+    }
+    if (opts->suffix && *opts->suffix) {
+        /* print suffix string */
+        outwritef(nb, "%s\n", opts->suffix);
+    }
+    if (outflush(nb) != 0) {
+        stop(nb, NANABOZO_EWRITE, "unable to write output");
+    }
+    if (opts->stats) {
+        stats_lap(nb, PHASE_FINISH);
+    }
+    return NANABOZO_OK;
+}
+int nanabozo_translate_stream( struct nanabozo *nb,
+        nanabozo_read_fn fn, void *arg )
+{
+    size_t len = 0;
+    long n;
+
+    /* read everything in a growing buffer, kept between translations */
+    for (;;) {
+        if (len == nb->srcsz) {
+            const size_t sz = nb->srcsz ? nb->srcsz * 2 : 16 * PAGESIZE;
+            char *p = realloc(nb->src, sz);
+            if (!p) {
+                return failed(nb, NANABOZO_ENOMEM, "no memory");
+            }
+            nb->src = p;
+            nb->srcsz = sz;
+        }
+        if ((n = (*fn)(arg, nb->src + len, nb->srcsz - len)) < 0) {
+            return failed(nb, NANABOZO_EREAD, "unable to read input");
+        }
+        if (!n) {
+            break;
+        }
+        len += (size_t) n;
+    }
+    return nanabozo_translate(nb, nb->src, len);
+}
+const char *nanabozo_errmsg( const struct nanabozo *nb )
+{
+    return nb->errmsg;
+}
+unsigned long nanabozo_lineno( const struct nanabozo *nb )
+{
+    return nb->lineno;
+}
+const struct nanabozo_stats *nanabozo_stats( const struct nanabozo *nb )
+{
+    return nb->opts.stats ? &nb->stats : NULL;
+}
+int nanabozo_valid_identifier( const char* id )
+{
+    if (!id || !*id || strlen(id) >= 256
+        || !strchr(NONDIGIT CPPSPECIAL, *id++))
+    {
+        return 0;
+    }
+    for (; *id; id++) {
+        if (!strchr(NONDIGIT DIGIT CPPSPECIAL, *id)) {
+            return 0;
+        }
+    }
+    return 1;
+}
+static void proceed( struct nanabozo *nb )
+{
+    /* counted in a copy of its own, the other one is left as it was */
+    if (nb->opts.stats) {
+        scan_lines(nb, 1);
+    }
+    else {
+        scan_lines(nb, 0);
+    }
+}
+static ALWAYS_INLINE void scan_lines( struct nanabozo *nb, const int stats )
+{
+    struct nanabozo_stats *const st = &nb->stats;
+    const struct match *mt = NULL;
+    const char *q;
+    int id;
+
+    while (read_input(nb)) {
+        while ((mt = context_match(nb, stats))) {
+            if (nb->match_p > nb->q) {
+                if (stats) {
+                    st->bytes[nb->context->id] +=
+                        (size_t) (nb->match_p - nb->q);
+                }
+                /* eat preceding string */
+                (*nb->context_fallback)(nb, nb->match_p);
+            }
+            assert(nb->q == nb->match_p);
+            if (stats) {
+                /* bytes eaten by the hook, in the context it started */
+                id = nb->context->id;
+                q = nb->q;
+                st->hooks[id][mt - nb->context->table]++;
+                (*mt->hook)(nb, mt);
+                st->bytes[id] += (size_t) (nb->q - q);
+            }
+            else {
+                (*mt->hook)(nb, mt);
+            }
+            if (nb->q == nb->eol) {
+                break;
+            }
+        }
+        /* no more matches in current line */
+        if (nb->q != nb->eol) {
+            if (stats) {
+                st->bytes[nb->context->id] += nb->q_len;
+            }
+            (*nb->context_fallback)(nb, NULL);
+        }
+    }
+    if (stats) {
+        /* lines of this script, or of this partial */
+        st->lines += nb->lineno;
+    }
+}
+static size_t read_input( struct nanabozo *nb )
+{
+    assert(nb->q == nb->eol && nb->q_len == 0);
+    if (nb->eol == nb->end) {
+        return 0;
+    }
+    /* next line, scanned in place */
+    nb->input = nb->q = nb->eol;
+    if ((nb->eol = memchr(nb->input, '\n', (size_t) (nb->end - nb->input)))) {
+        nb->eol++;
+    }
+    else {
+        nb->eol = nb->end;
+    }
+    nb->q_len = (size_t) (nb->eol - nb->input);
+    /* increment line count */
+    nb->lineno++;
+    return nb->q_len;
+}
+static ALWAYS_INLINE const struct match *context_match( struct nanabozo *nb,
+        const int stats )
+{
+    const struct matcher *const m = nb->context;
+    const char *const eol = nb->eol;
+    const struct match *mt;
+    unsigned int i;
+    const char *p;
+
+    assert(nb->q != eol);
+    for (p = nb->q; (p = (*nb->skip)(m, p, eol)) != eol; p++) {
+        if (stats) {
+            nb->stats.skips++;
+        }
+        for (i = m->first[(unsigned char) *p]; i; i = m->next[i-1]) {
+            mt = &m->table[i-1];
+            if (stats) {
+                nb->stats.compares++;
+            }
+            if (mt->len <= (size_t) (eol - p)
+                && !memcmp(p + 1, mt->str + 1, mt->len - 1))
+            {
+                /* nearest match, longest first */
+                nb->match_p = p;
+                return mt;
+            }
+        }
+    }
+    return NULL;
+}
+static void compile_matcher( struct matcher *m, const struct match *table,
+        const int id )
+{
+    unsigned char last[256];
+    unsigned int i;
+    const struct match *mt = table;
+
+    m->table = table;
+    m->id = id;
+    memset(m->first, 0, sizeof(m->first));
+    memset(m->next, 0, sizeof(m->next));
+    memset(last, 0, sizeof(last));
+    m->nlead = 0;
+    for (i = 0; mt->str; mt++, i++) {
+        const unsigned char c = (unsigned char) *mt->str;
+        assert(i < sizeof(m->next) && mt->len == strlen(mt->str));
+        if (!last[c]) {
+            assert(m->nlead < (int) sizeof(m->lead));
+            m->lead[m->nlead++] = (char) c;
+            m->first[c] = i + 1;
+        }
+        else {
+            m->next[last[c]-1] = i + 1;
+        }
+        last[c] = i + 1;
+    }
+}
+static skip_fn select_scanner( void )
+{
+#ifdef HAVE_SSE2
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2") ? &skip_avx2 : &skip_sse2;
+#else
+    return &skip_scalar;
+#endif
+}
+static const char *skip_scalar( const struct matcher *m,
+        const char *p, const char *end )
+{
+    while (p != end && !m->first[(unsigned char) *p]) {
+        p++;
+    }
+    return p;
+}
+#ifdef HAVE_SSE2
+static const char *skip_sse2( const struct matcher *m,
+        const char *p, const char *end )
+{
+    __m128i lead[sizeof(m->lead)];
+    int i;
+
+    for (i = 0; i < m->nlead; i++) {
+        lead[i] = _mm_set1_epi8(m->lead[i]);
+    }
+    for (; end - p >= 16; p += 16) {
+        const __m128i v = _mm_loadu_si128((const __m128i *) p);
+        __m128i eq = _mm_cmpeq_epi8(v, lead[0]);
+        unsigned int mask;
+        for (i = 1; i < m->nlead; i++) {
+            eq = _mm_or_si128(eq, _mm_cmpeq_epi8(v, lead[i]));
+        }
+        if ((mask = (unsigned int) _mm_movemask_epi8(eq))) {
+            return p + __builtin_ctz(mask);
+        }
+    }
+    return skip_scalar(m, p, end);
+}
+__attribute__((target("avx2")))
+static const char *skip_avx2( const struct matcher *m,
+        const char *p, const char *end )
+{
+    __m256i lead[sizeof(m->lead)];
+    const char *q;
+    int i;
+
+    /* most hits are near, probe the first 16 bytes only */
+    if (end - p >= 16) {
+        if ((q = skip_sse2(m, p, p + 16)) != p + 16) {
+            return q;
+        }
+        p += 16;
+    }
+    for (i = 0; i < m->nlead; i++) {
+        lead[i] = _mm256_set1_epi8(m->lead[i]);
+    }
+    for (; end - p >= 32; p += 32) {
+        const __m256i v = _mm256_loadu_si256((const __m256i *) p);
+        __m256i eq = _mm256_cmpeq_epi8(v, lead[0]);
+        unsigned int mask;
+        for (i = 1; i < m->nlead; i++) {
+            eq = _mm256_or_si256(eq, _mm256_cmpeq_epi8(v, lead[i]));
+        }
+        if ((mask = (unsigned int) _mm256_movemask_epi8(eq))) {
+            return p + __builtin_ctz(mask);
+        }
+    }
+    /* leave no dirty upper state to the legacy SSE code */
+    _mm256_zeroupper();
+    return skip_sse2(m, p, end);
+}
+#endif /* HAVE_SSE2 */
+static void scan_include( struct nanabozo *nb )
+{
+    const char *p = nb->q + 1, *name;
+    const char *const eol = nb->eol;
+
+    /* cursor is on '#', look for: include "name" */
+    while (p != eol && (*p == ' ' || *p == '\t')) {
+        p++;
+    }
+    if ((size_t) (eol - p) < 7 || memcmp(p, "include", 7)) {
+        return;
+    }
+    for (p += 7; p != eol && (*p == ' ' || *p == '\t'); p++) {
+        ;
+    }
+    if (p == eol || *p != '"') {
+        return;
+    }
+    for (name = ++p; p != eol && *p != '"' && *p != '\n'; p++) {
+        ;
+    }
+    if (p != eol && *p == '"' && p != name
+        && (*nb->include)(nb->include_arg, name, (size_t) (p - name)) != 0)
+    {
+        stop(nb, NANABOZO_ECALLBACK, "translation aborted");
+    }
+}
+static const char *partial_name( const char *p, const char *end,
+        const char **name, size_t *len )
+{
+    /* p is after "<?include ", look for: "name" ?> */
+    while (p != end && (*p == ' ' || *p == '\t')) {
+        p++;
+    }
+    if (p == end || *p != '"') {
+        return NULL;
+    }
+    for (*name = ++p; p != end && *p != '"' && *p != '\n'; p++) {
+        ;
+    }
+    if (p == end || *p != '"' || p == *name) {
+        return NULL;
+    }
+    *len = (size_t) (p - *name);
+    for (p++; p != end && (*p == ' ' || *p == '\t'); p++) {
+        ;
+    }
+    if (end - p < 2 || p[0] != '?' || p[1] != '>') {
+        return NULL;
+    }
+    return p + 2;
+}
+static int prescan_partials( struct nanabozo *nb, const char *p,
+        const char *end )
+{
+    /* cursor, that a stopped scan_partial leaves as is */
+    const char *const input = nb->input, *const eol = nb->eol;
+    const char *const q = nb->q, *const src_end = nb->end;
+    const size_t q_len = nb->q_len;
+    const unsigned long lineno = nb->lineno;
+    struct matcher *const context = nb->context;
+    void (*const fallback)( struct nanabozo *nb, const char *eol )
+        = nb->context_fallback;
+    const int verbatim = nb->verbatim;
+    const char *volatile at = p;
+    volatile int needs = 0;
+    struct partial *pt;
+    const char *name;
+    size_t len;
+    jmp_buf env;
+
+    memcpy(env, nb->env, sizeof(jmp_buf));
+    if (setjmp(nb->env)) {
+        if (nb->stopping != NANABOZO_ESCRIPT
+            && nb->stopping != NANABOZO_ECALLBACK)
+        {
+            memcpy(nb->env, env, sizeof(jmp_buf));
+            longjmp(nb->env, 1);
+        }
+        /* the match may be in a comment or a string, not a directive:
+           errors are reported by partial_start, where met */
+        for (pt = nb->partials; pt; pt = pt->next) {
+            pt->busy = 0;
+            pt->stamp = 0;
+        }
+        nb->stopping = 0;
+        nb->errmsg[0] = '\0';
+        nb->includer = NULL;
+        nb->input = input;
+        nb->eol = eol;
+        nb->q = q;
+        nb->q_len = q_len;
+        nb->end = src_end;
+        nb->lineno = lineno;
+        nb->context = context;
+        nb->context_fallback = fallback;
+        nb->verbatim = verbatim;
+        at++;
+    }
+    while ((at = memchr(at, '<', (size_t) (end - at))) && end - at >= 10) {
+        if (!memcmp(at, "<?include ", 10)
+            && partial_name(at + 10, end, &name, &len)
+            && (pt = check_partial(nb, name, len, 0, 1)))
+        {
+            /* missing ones are reported where met */
+            needs |= pt->needs_all;
+        }
+        at++;
+    }
+    memcpy(nb->env, env, sizeof(jmp_buf));
+    return needs;
+}
+static struct partial *check_partial( struct nanabozo *nb, const char *name,
+        const size_t len, const int depth, const int quiet )
+{
+    struct partial *pt, *const includer = nb->includer;
+    const unsigned long lineno = nb->lineno;
+    unsigned long long h = 14695981039346656037ULL; /* FNV-1a */
+    const char *src, *p;
+    size_t i, srclen;
+
+    for (pt = nb->partials; pt; pt = pt->next) {
+        if (pt->name_len == len && !memcmp(pt->name, name, len)) {
+            break;
+        }
+    }
+    if (pt && pt->busy) {
+        stop2(nb, NANABOZO_ESCRIPT, "partial '%s' includes itself", pt->name);
+    }
+    if (pt && pt->stamp == nb->stamp) {
+        /* checked already, for this translation */
+        return pt;
+    }
+    if (depth == PARTIAL_DEPTH) {
+        stop(nb, NANABOZO_ESCRIPT, "partials nested too deep");
+    }
+    if ((*nb->partial)(nb->partial_arg, name, len, &src, &srclen) != 0) {
+        if (quiet) {
+            return NULL;
+        }
+        stop2(nb, NANABOZO_ECALLBACK, "unable to include '%.*s'",
+                (int) len, name);
+    }
+    for (p = src; p != src + srclen; p++) {
+        h ^= (unsigned char) *p;
+        h *= 1099511628211ULL;
+    }
+    if (!pt) {
+        if (!(pt = calloc(1, sizeof(struct partial)))
+            || !(pt->name = malloc(len + 1)))
+        {
+            free(pt);
+            stop(nb, NANABOZO_ENOMEM, "no memory");
+        }
+        memcpy(pt->name, name, len);
+        pt->name[len] = '\0';
+        pt->name_len = len;
+        pt->next = nb->partials;
+        nb->partials = pt;
+    }
+    if (!pt->translated || pt->hash != h || pt->src_len != srclen) {
+        /* new or changed, scanned once */
+        reset_partial(pt);
+        pt->hash = h;
+        pt->src_len = srclen;
+        scan_partial(nb, pt, src, srclen);
+    }
+    /* its own partials may have changed */
+    pt->stamp = nb->stamp;
+    pt->busy = 1;
+    pt->needs_all = pt->needs;
+    nb->includer = pt;
+    for (i = 0; i < pt->splices_len; i++) {
+        struct splice *const sp = pt->splices[i];
+        nb->lineno = sp->lineno;
+        sp->partial = check_partial(nb, sp->name, sp->len, depth + 1, 0);
+        pt->needs_all |= sp->partial->needs_all;
+    }
+    pt->busy = 0;
+    nb->includer = includer;
+    nb->lineno = lineno;
+    return pt;
+}
+static void scan_partial( struct nanabozo *nb, struct partial *pt,
+        const char *src, const size_t len )
+{
+    /* cursor of the includer, that goes on after */
+    const char *const input = nb->input, *const eol = nb->eol;
+    const char *const q = nb->q, *const end = nb->end;
+    const size_t q_len = nb->q_len;
+    const unsigned long lineno = nb->lineno;
+    struct matcher *const context = nb->context;
+    void (*const fallback)( struct nanabozo *nb, const char *eol )
+        = nb->context_fallback;
+    const int verbatim = nb->verbatim;
+    struct partial *const includer = nb->includer;
+
+    assert(!nb->scanned && !nb->buf_len);
+    if (outflush(nb) != 0) {
+        stop(nb, NANABOZO_EWRITE, "unable to write output");
+    }
+    /* its code is kept aside */
+    nb->scanned = pt;
+    nb->scanned_write = nb->write;
+    nb->scanned_write_arg = nb->write_arg;
+    nb->write = &write_partial;
+    nb->write_arg = pt;
+    nb->includer = pt;
+    nb->input = nb->eol = nb->q = src;
+    nb->end = src + len;
+    nb->q_len = 0;
+    nb->lineno = 0;
+    nb->context = &nb->html_matcher;
+    nb->context_fallback = &html_fallback;
+    nb->verbatim = 0;
+    proceed(nb);
+    if (nb->context != &nb->html_matcher) {
+        stop(nb, NANABOZO_ESCRIPT, "eof while scanning partial");
+    }
+    bufout(nb);
+    if (outflush(nb) != 0) {
+        stop(nb, NANABOZO_ENOMEM, "no memory");
+    }
+    pt->needs = needed_headers(src, src + len, nb->opts.compile_formats);
+    pt->translated = 1;
+    nb->write = nb->scanned_write;
+    nb->write_arg = nb->scanned_write_arg;
+    nb->scanned = NULL;
+    nb->includer = includer;
+    nb->input = input;
+    nb->eol = eol;
+    nb->q = q;
+    nb->q_len = q_len;
+    nb->end = end;
+    nb->lineno = lineno;
+    nb->context = context;
+    nb->context_fallback = fallback;
+    nb->verbatim = verbatim;
+}
+static void splice_partial( struct nanabozo *nb, const struct partial *pt )
+{
+    size_t i, at = 0;
+
+    for (i = 0; i < pt->splices_len; i++) {
+        const struct splice *const sp = pt->splices[i];
+        outwrite(nb, pt->out + at, sp->at - at);
+        splice_partial(nb, sp->partial);
+        at = sp->at;
+    }
+    outwrite(nb, pt->out + at, pt->out_len - at);
+}
+static void add_splice( struct nanabozo *nb, struct partial *pt,
+        const char *name, const size_t len )
+{
+    struct splice *sp;
+
+    /* its code so far */
+    if (outflush(nb) != 0) {
+        stop(nb, NANABOZO_ENOMEM, "no memory");
+    }
+    if (pt->splices_len == pt->splicesz) {
+        const size_t sz = pt->splicesz ? pt->splicesz * 2 : 8;
+        struct splice **p = realloc(pt->splices, sz * sizeof(*p));
+        if (!p) {
+            stop(nb, NANABOZO_ENOMEM, "no memory");
+        }
+        pt->splices = p;
+        pt->splicesz = sz;
+    }
+    if (!(sp = malloc(sizeof(struct splice) + len))) {
+        stop(nb, NANABOZO_ENOMEM, "no memory");
+    }
+    sp->at = pt->out_len;
+    sp->lineno = nb->lineno;
+    sp->partial = NULL;
+    sp->len = len;
+    memcpy(sp->name, name, len);
+    sp->name[len] = '\0';
+    pt->splices[pt->splices_len++] = sp;
+}
+static void reset_partial( struct partial *pt )
+{
+    while (pt->splices_len) {
+        free(pt->splices[--pt->splices_len]);
+    }
+    pt->out_len = 0;
+    pt->translated = 0;
+    pt->needs = 0;
+}
+static int write_partial( void *arg, const char *s, size_t len )
+{
+    struct partial *const pt = arg;
+
+    if (pt->out_len + len > pt->outsz) {
+        size_t sz = pt->outsz ? pt->outsz : PAGESIZE;
+        char *p;
+        while (sz < pt->out_len + len) {
+            sz *= 2;
+        }
+        if (!(p = realloc(pt->out, sz))) {
+            return -1;
+        }
+        pt->out = p;
+        pt->outsz = sz;
+    }
+    memcpy(pt->out + pt->out_len, s, len);
+    pt->out_len += len;
+    return 0;
+}
+static int write_stdout( void *arg, const char *s, size_t len )
+{
+    (void) arg;
+    return fwrite(s, sizeof(char), len, stdout) != len ? -1 : 0;
+}
+static void stats_lap( struct nanabozo *nb, const int phase )
+{
+    const clock_t cpu = clock();
+    struct timespec ts;
+    double wall;
+
+    timespec_get(&ts, TIME_UTC);
+    wall = (double) ts.tv_sec + (double) ts.tv_nsec / 1e9;
+    if (phase >= 0) {
+        /* end of that phase, start of the next one */
+        nb->stats.wall[phase] += wall - nb->lap_wall;
+        nb->stats.cpu[phase] += (double) (cpu - nb->lap_cpu) / CLOCKS_PER_SEC;
+    }
+    nb->lap_wall = wall;
+    nb->lap_cpu = cpu;
+}
+static void profile_begin( struct nanabozo *nb, const char *kind,
+        const unsigned long line )
+{
+    outwrites(nb, "NANABOZO_PROFILE_BEGIN(");
+    if (nb->scanned) {
+        /* code of partials is spliced, keyed by their name */
+        profile_string(nb, nb->scanned->name);
+    }
+    else {
+        outwrites(nb, "NANABOZO_PROFILE_FILE");
+    }
+    outwritef(nb, ", \"%s\", %lu)\n", kind, line);
+}
+static void profile_end( struct nanabozo *nb )
+{
+    outwrites(nb, "\nNANABOZO_PROFILE_END");
+}
+static void profile_string( struct nanabozo *nb, const char *s )
+{
+    /* a file name, as a C string literal */
+    output(nb, '"');
+    for (; *s; s++) {
+        if (*s == '\\' || *s == '"') {
+            output(nb, '\\');
+        }
+        output(nb, *s);
+    }
+    output(nb, '"');
+}
+static int failed( struct nanabozo *nb, const int err, const char *msg )
+{
+    /* error outside of translation */
+    snprintf(nb->errmsg, sizeof(nb->errmsg), "%s", msg);
+    nb->lineno = 0;
+    return err;
+}
+static inline void bufwrite( struct nanabozo *nb,
+        const char *s, const size_t len )
+{
+    if (!nb->buf_len) {
+        /* line the html region starts */
+        nb->buf_line = nb->lineno;
+    }
+    if (nb->buf_len + len >= nb->bufsz) {
+        bufgrow(nb, len);
+    }
+    memcpy(nb->buf + nb->buf_len, s, len);
+    nb->buf_len += len;
+}
+static void bufout( struct nanabozo *nb )
+{
+    char *p = nb->buf;
+    size_t len = 0; /* bytes printed, known to print_n */
+
+    if (!nb->buf_len) {
+        return;
+    }
+    if (nb->opts.stats) {
+        nb->stats.flushes++;
+        nb->stats.flushed += nb->buf_len;
+        if (nb->buf_len > nb->stats.html_peak) {
+            nb->stats.html_peak = nb->buf_len;
+        }
+    }
+    nb->buf[nb->buf_len] = '\0';
+    nb->buf_len = 0;
+    /* dont send trailing spaces */
+    if (nb->reached_eof) {
+        while (*p && isspace((unsigned char) *p)) {
+            ++p;
+        }
+        if (!*p) {
+            return;
+        }
+        p = nb->buf;
+    }
+    output(nb, '\n');
+    if (nb->opts.profile_regions) {
+        profile_begin(nb, "html", nb->buf_line);
+    }
+    /* transfer buffer to output */
+    outwritef(nb, "%s(\"", nb->opts.sized ? nb->print_n : nb->print);
+    for (;; p++) {
+        const char *span = p;
+        /* copy clean spans in one go */
+        while (!_escaped[(unsigned char) *p]) {
+            p++;
+        }
+        if (p != span) {
+            outwrite(nb, span, (size_t) (p - span));
+            len += (size_t) (p - span);
+        }
+        switch (*p) {
+        case '\0':
+            goto bufout_end;
+        case '\a':
+        case '\b':
+        case '\f':
+        case '\v':
+            /* dropped */
+            continue;
+        case '\\':
+            outwrite(nb, "\\\\", 2);
+            break;
+        case '"':
+            outwrite(nb, "\\\"", 2);
+            break;
+        case '\n':
+            if (*(p+1)) {
+                outwrite(nb, "\\n\"\n\"", 5);
+            }
+            else {
+                outwrite(nb, "\\n\"", 3);
+            }
+            break;
+        case '\r':
+            outwrite(nb, "\\r", 2);
+            break;
+        case '\t':
+            outwrite(nb, "\\t", 2);
+            break;
+        }
+        len++;
+    }
+bufout_end:
+    if (*(p-1) != '\n') {
+        output(nb, '"');
+    }
+    if (nb->opts.sized) {
+        outwritef(nb, ", %lu", (unsigned long) len);
+    }
+    outwrite(nb, ");\n", 3);
+    if (nb->opts.profile_regions) {
+        outwrites(nb, "NANABOZO_PROFILE_END\n");
+    }
+}
+static inline void bufput( struct nanabozo *nb, const int c )
+{
+    if (!nb->buf_len) {
+        nb->buf_line = nb->lineno;
+    }
+    if (nb->buf_len + 1 >= nb->bufsz) {
+        bufgrow(nb, 1);
+    }
+    nb->buf[nb->buf_len++] = (char) c;
+}
+static void bufgrow( struct nanabozo *nb, const size_t len )
+{
+    size_t sz = nb->bufsz ? nb->bufsz : PAGESIZE;
+    char *b;
+
+    /* keep room for a terminating null */
+    while (sz <= nb->buf_len + len) {
+        sz *= 2;
+    }
+    if (sz == nb->bufsz) {
+        return;
+    }
+    if (!(b = realloc(nb->buf, sz))) {
+        stop(nb, NANABOZO_ENOMEM, "no memory");
+    }
+    nb->buf = b;
+    nb->bufsz = sz;
+}
+static void outwrite( struct nanabozo *nb, const char *s, const size_t len )
+{
+    if (nb->out_len + len > OUTSIZE) {
+        if (outflush(nb) != 0) {
+            stop(nb, NANABOZO_EWRITE, "unable to write output");
+        }
+        if (len > OUTSIZE) {
+            /* too big to be buffered */
+            if (outsend(nb, s, len) != 0) {
+                stop(nb, NANABOZO_EWRITE, "unable to write output");
+            }
+            return;
+        }
+    }
+    memcpy(nb->out + nb->out_len, s, len);
+    nb->out_len += len;
+    if (nb->opts.line_buffered && memchr(s, '\n', len)
+        && outflush(nb) != 0)
+    {
+        stop(nb, NANABOZO_EWRITE, "unable to write output");
+    }
+}
+static void outwrites( struct nanabozo *nb, const char *s )
+{
+    outwrite(nb, s, strlen(s));
+}
+static void outwritef( struct nanabozo *nb, const char *fmt, ... )
+{
+    va_list ap;
+    int n;
+
+    va_start(ap, fmt);
+    n = vsnprintf(nb->out + nb->out_len, OUTSIZE - nb->out_len, fmt, ap);
+    va_end(ap);
+    if (n < 0) {
+        stop(nb, NANABOZO_EWRITE, "unable to write output");
+    }
+    if ((size_t) n >= OUTSIZE - nb->out_len) {
+        /* did not fit, flush and retry */
+        if (outflush(nb) != 0) {
+            stop(nb, NANABOZO_EWRITE, "unable to write output");
+        }
+        va_start(ap, fmt);
+        if ((size_t) n < OUTSIZE) {
+            vsnprintf(nb->out, OUTSIZE, fmt, ap);
+            nb->out_len = (size_t) n;
+        }
+        else {
+            /* too big to be buffered */
+            char *tmp = malloc((size_t) n + 1);
+            if (!tmp) {
+                va_end(ap);
+                stop(nb, NANABOZO_ENOMEM, "no memory");
+            }
+            vsnprintf(tmp, (size_t) n + 1, fmt, ap);
+            if (outsend(nb, tmp, (size_t) n) != 0) {
+                free(tmp);
+                va_end(ap);
+                stop(nb, NANABOZO_EWRITE, "unable to write output");
+            }
+            free(tmp);
+        }
+        va_end(ap);
+    }
+    else {
+        nb->out_len += (size_t) n;
+    }
+    if (nb->opts.line_buffered && outflush(nb) != 0) {
+        stop(nb, NANABOZO_EWRITE, "unable to write output");
+    }
+}
+static void output( struct nanabozo *nb, const int c )
+{
+    if (nb->out_len == OUTSIZE && outflush(nb) != 0) {
+        stop(nb, NANABOZO_EWRITE, "unable to write output");
+    }
+    nb->out[nb->out_len++] = (char) c;
+    if (nb->opts.line_buffered && c == '\n' && outflush(nb) != 0) {
+        stop(nb, NANABOZO_EWRITE, "unable to write output");
+    }
+}
+static int outflush( struct nanabozo *nb )
+{
+    const size_t len = nb->out_len;
+
+    nb->out_len = 0;
+    if (!len) {
+        return 0;
+    }
+    return outsend(nb, nb->out, len);
+}
+static int outsend( struct nanabozo *nb, const char *s, const size_t len )
+{
+    if (nb->opts.stats && !nb->scanned) {
+        /* code of partials is only counted where spliced */
+        nb->stats.writes++;
+        nb->stats.written += len;
+    }
+    return (*nb->write)(nb->write_arg, s, len);
+}
+static int cursor( struct nanabozo *nb )
+{
+  if (nb->q != nb->eol || read_input(nb)) {
+      nb->q_len--;
+      return *nb->q++;
+  }
+  return EOF;
+}
+static void cursor_to( struct nanabozo *nb, const char *p )
+{
+    /* p is further in the script */
+    while (p > nb->eol) {
+        nb->q = nb->eol;
+        nb->q_len = 0;
+        read_input(nb);
+    }
+    nb->q_len -= (size_t) (p - nb->q);
+    nb->q = p;
+}
+static void c_fallback( struct nanabozo *nb, const char *eol )
+{
+    const size_t sz = eol ? (size_t) (eol - nb->q) : nb->q_len;
+    assert(nb->q != nb->eol && sz);
+    outwrite(nb, nb->q, sz);
+    nb->q += sz;
+    nb->q_len -= sz;
+}
+static void html_fallback( struct nanabozo *nb, const char *eol )
+{
+    const size_t sz = eol ? (size_t) (eol - nb->q) : nb->q_len;
+    assert(nb->q != nb->eol && sz);
+    if (nb->opts.minify && !nb->verbatim) {
+        minify_write(nb, nb->q, sz);
+    }
+    else {
+        bufwrite(nb, nb->q, sz);
+    }
+    nb->q += sz;
+    nb->q_len -= sz;
+}
+static void minify_write( struct nanabozo *nb, const char *s, size_t len )
+{
+    /* any run of spaces is one space, but in scripts (regexps) */
+    const int collapse = nb->context != &nb->script_matcher;
+    const char *const end = s + len;
+
+    while (s != end) {
+        const char *span = s;
+        int c, prev;
+        while (s != end && !isspace((unsigned char) *s)) {
+            s++;
+        }
+        if (s != span) {
+            bufwrite(nb, span, (size_t) (s - span));
+            continue;
+        }
+        c = *s++;
+        prev = nb->buf_len ? (unsigned char) nb->buf[nb->buf_len - 1] : 0;
+        if (!isspace(prev)) {
+            /* first of a run */
+            bufput(nb, c == '\n' || !collapse ? c : ' ');
+        }
+        else if (c == '\n' && prev != '\n') {
+            /* a run with a newline is a newline, trailing spaces go */
+            while (nb->buf_len && isspace((unsigned char)
+                        nb->buf[nb->buf_len - 1]))
+            {
+                nb->buf_len--;
+            }
+            bufput(nb, '\n');
+        }
+        else if (!collapse && prev != '\n' && c != '\n') {
+            /* spaces inside a script line are kept */
+            bufput(nb, c);
+        }
+    }
+}
+static void minify_tag( struct nanabozo *nb )
+{
+    static const char *const names[] = { "pre", "textarea", NULL };
+    const char *p = nb->q + 1;
+    const int closing = p != nb->eol && *p == '/';
+    int i;
+
+    p += closing;
+    for (i = 0; names[i]; i++) {
+        const char *n = names[i];
+        const char *t = p;
+        while (*n && t != nb->eol && tolower((unsigned char) *t) == *n) {
+            n++;
+            t++;
+        }
+        if (!*n && (t == nb->eol || !isalnum((unsigned char) *t))) {
+            nb->verbatim = !closing;
+            return;
+        }
+    }
+}
+static int needed_headers( const char *p, const char *end,
+        const int formats )
+{
+    int needs = 0;
+    while ((p = memchr(p, '<', (size_t) (end - p))) && end - p >= 3) {
+        if (p[1] == '?' && p[2] == '-') {
+            needs |= NEEDS_ESCAPE;
+        }
+        else if (p[1] == '?' && p[2] == '%' && (formats || (end - p >= 5
+            && p[4] == ' ' && (p[3] == 'd' || p[3] == 'u' || p[3] == 'x'))))
+        {
+            needs |= NEEDS_FORMAT;
+        }
+        p++;
+    }
+    return needs;
+}
+static int string_tag_start( struct nanabozo *nb, const int c )
+{
+    const char *const q = nb->q;
+    if (c != '<' || nb->eol - q < 2 || q[0] != '?') {
+        return 0;
+    }
+    if (q[1] == '-' && nb->context != &nb->style_matcher) {
+        /* escaped for attribute values and script strings, not style */
+        if (nb->context == &nb->tag_matcher && !nb->value_escaper) {
+            stop(nb, NANABOZO_ESCRIPT,
+                    "escaped value in style or unnamed attribute");
+        }
+        nb->q += 2;
+        nb->q_len -= 2;
+        c_escape_string(nb, nb->context == &nb->tag_matcher
+                ? nb->value_escaper : "js");
+        return 1;
+    }
+    if (nb->eol - q >= 4 && q[1] == '%' && q[3] == ' '
+        && (q[2] == 'd' || q[2] == 'u' || q[2] == 'x'))
+    {
+        /* numbers need no escaping */
+        nb->q += 4;
+        nb->q_len -= 4;
+        c_print_number(nb, q[2]);
+        return 1;
+    }
+    return 0;
+}
+static const char *value_escaper( const struct nanabozo *nb )
+{
+    /* the buffer ends with name= and the opening quote */
+    const char *const buf = nb->buf;
+    size_t i = nb->buf_len - 1, j;
+
+    while (i && isspace((unsigned char) buf[i - 1])) {
+        i--;
+    }
+    if (!i || buf[i - 1] != '=') {
+        return "attr";
+    }
+    i--;
+    while (i && isspace((unsigned char) buf[i - 1])) {
+        i--;
+    }
+    j = i;
+    while (i && !isspace((unsigned char) buf[i - 1]) && buf[i - 1] != '"'
+        && buf[i - 1] != '\'' && buf[i - 1] != '<')
+    {
+        i--;
+    }
+    if (!i || i == j) {
+        /* the name was printed by a tag */
+        return NULL;
+    }
+    if (j - i >= 2 && tolower((unsigned char) buf[i]) == 'o'
+        && tolower((unsigned char) buf[i + 1]) == 'n')
+    {
+        /* event handler, javascript decoded from html */
+        return "js_attr";
+    }
+    if (j - i == 5 && tolower((unsigned char) buf[i]) == 's'
+        && tolower((unsigned char) buf[i + 1]) == 't'
+        && tolower((unsigned char) buf[i + 2]) == 'y'
+        && tolower((unsigned char) buf[i + 3]) == 'l'
+        && tolower((unsigned char) buf[i + 4]) == 'e')
+    {
+        return NULL;
+    }
+    return "attr";
+}
+static int compile_format( struct nanabozo *nb )
+{
+    struct format_piece pieces[FORMAT_PIECES];
+    const char *const end = nb->end;
+    const char *p = nb->q;
+    const char *seg;
+    const int direct = nb->opts.buffer || nb->opts.fastcgi || nb->opts.cxx;
+    /* a char may be nul, printed with its length only */
+    const int chars = direct || (nb->opts.sized && !nb->opts.writev);
+    size_t npieces = 0, nconv = 0, size = 0, i, k;
+
+    /* the format, a single string literal */
+    while (p != end && isspace((unsigned char) *p)) {
+        p++;
+    }
+    if (p == end || *p != '"') {
+        return 0;
+    }
+    for (seg = ++p;; ) {
+        if (p == end || *p == '\n' || npieces >= FORMAT_PIECES - 1) {
+            return 0;
+        }
+        if (*p == '"') {
+            break;
+        }
+        if (*p == '\\') {
+            /* no escape that could hide a percent sign */
+            if (end - p < 2 || !p[1] || !strchr("ntr\"\\'abfv?", p[1])) {
+                return 0;
+            }
+            p += 2;
+            size++;
+            continue;
+        }
+        if (*p != '%') {
+            p++;
+            size++;
+            continue;
+        }
+        if (end - p >= 2 && p[1] == '%') {
+            /* the text keeps one percent sign */
+            const struct format_piece text = { seg, (size_t) (p + 1 - seg),
+                size + 1, 0, NULL };
+            pieces[npieces++] = text;
+            p += 2;
+            seg = p;
+            size = 0;
+            continue;
+        }
+        if (p != seg) {
+            const struct format_piece text = { seg, (size_t) (p - seg),
+                size, 0, NULL };
+            pieces[npieces++] = text;
+        }
+        /* length modifiers, then conversion (no flags, width, precision) */
+        for (seg = ++p; p != end && (*p == 'h' || *p == 'l' || *p == 'z'); ) {
+            p++;
+        }
+        if (p == end) {
+            return 0;
+        }
+        else {
+            const struct format_piece conv = { NULL, 0, 0,
+                *p == 'i' ? 'd' : *p, format_type(seg, (size_t) (p - seg), *p) };
+            if (!conv.type || (conv.conv == 'c' && !chars)) {
+                return 0;
+            }
+            pieces[npieces++] = conv;
+            nconv++;
+        }
+        seg = ++p;
+        size = 0;
+    }
+    if (p != seg) {
+        const struct format_piece text = { seg, (size_t) (p - seg),
+            size, 0, NULL };
+        pieces[npieces++] = text;
+    }
+    p++;
+    /* arguments, split at commas outside of brackets */
+    for (k = 0; ; k++) {
+        const char *arg;
+        int depth = 0;
+        while (p != end && isspace((unsigned char) *p)) {
+            p++;
+        }
+        if (end - p >= 2 && p[0] == '?' && p[1] == '>') {
+            break;
+        }
+        if (p == end || *p != ',' || k == nconv) {
+            return 0;
+        }
+        for (arg = ++p; p != end; p++) {
+            if (*p == '"' || *p == '\'') {
+                if (!(p = skip_c_literal(p, end))) {
+                    return 0;
+                }
+                p--;
+            }
+            else if (*p == '/' && end - p >= 2 && (p[1] == '*' || p[1] == '/')) {
+                return 0;
+            }
+            else if (*p == '(' || *p == '[' || *p == '{') {
+                depth++;
+            }
+            else if (*p == ')' || *p == ']' || *p == '}') {
+                if (!depth--) {
+                    return 0;
+                }
+            }
+            else if (*p == '?' && end - p >= 2 && p[1] == '>') {
+                if (depth) {
+                    return 0;
+                }
+                break;
+            }
+            else if (*p == ',' && !depth) {
+                break;
+            }
+        }
+        if (p == end) {
+            return 0;
+        }
+        /* k-th conversion */
+        for (i = 0; i < npieces && (!pieces[i].conv || pieces[i].s); i++)
+            ;
+        pieces[i].s = arg;
+        pieces[i].len = (size_t) (p - arg);
+    }
+    if (k != nconv) {
+        return 0;
+    }
+    cursor_to(nb, p + 2);
+    /* arguments are all evaluated first, as with printf */
+    outwrite(nb, "{ ", 2);
+    for (i = 0, k = 0; i < npieces; i++) {
+        if (pieces[i].conv) {
+            outwritef(nb, "%snanabozo_a%lu = (", pieces[i].type,
+                    (unsigned long) k++);
+            outwrite(nb, pieces[i].s, pieces[i].len);
+            outwrite(nb, ");\n", 3);
+        }
+    }
+    /*
+     *  Runs of text and numbers are put together, and strings are printed,
+     *  but with a response buffer or a C++ sink, where printing is as cheap
+     *  as copying.
+     */
+    for (i = 0, k = 0; i < npieces; ) {
+        const struct format_piece *pc = &pieces[i];
+        size_t j, text = 1, numbers = 0;
+        if (pc->conv == 's') {
+            outwritef(nb, "%s(nanabozo_a%lu ? nanabozo_a%lu : \"(null)\");\n",
+                    nb->print, (unsigned long) k, (unsigned long) k);
+            i++;
+            k++;
+            continue;
+        }
+        if (!pc->conv && (direct || i + 1 == npieces
+                || pieces[i + 1].conv == 's'))
+        {
+            /* literals are never copied */
+            outwritef(nb, "%s(\"", nb->opts.sized ? nb->print_n : nb->print);
+            outwrite(nb, pc->s, pc->len);
+            if (nb->opts.sized) {
+                outwritef(nb, "\", %lu);\n", (unsigned long) pc->size);
+            }
+            else {
+                outwrite(nb, "\");\n", 4);
+            }
+            i++;
+            continue;
+        }
+        if (direct) {
+            if (pc->conv == 'c') {
+                outwritef(nb, "{ const char nanabozo_c = (char) nanabozo_a%lu;\n"
+                        "%s(&nanabozo_c, 1); }\n", (unsigned long) k,
+                        nb->print_n);
+            }
+            else {
+                outwritef(nb, "{ char nanabozo_i[NANABOZO_FORMAT_INT];\n"
+                        "%s(nanabozo_i, nanabozo_format_%c(nanabozo_i, "
+                        "nanabozo_a%lu)); }\n", nb->print_n, pc->conv,
+                        (unsigned long) k);
+            }
+            i++;
+            k++;
+            continue;
+        }
+        for (j = i; j < npieces && pieces[j].conv != 's'; j++) {
+            text += pieces[j].size;
+            numbers += pieces[j].conv != 0;
+        }
+        outwritef(nb, "{ char nanabozo_o[%lu + %lu * NANABOZO_FORMAT_INT];\n"
+                "size_t nanabozo_n = 0;\n", (unsigned long) text,
+                (unsigned long) numbers);
+        for (; i < j; i++) {
+            pc = &pieces[i];
+            if (!pc->conv) {
+                outwrites(nb, "memcpy(nanabozo_o + nanabozo_n, \"");
+                outwrite(nb, pc->s, pc->len);
+                outwritef(nb, "\", %lu);\nnanabozo_n += %lu;\n",
+                        (unsigned long) pc->size, (unsigned long) pc->size);
+            }
+            else if (pc->conv == 'c') {
+                outwritef(nb, "nanabozo_o[nanabozo_n++] = (char) nanabozo_a%lu;\n",
+                        (unsigned long) k++);
+            }
+            else {
+                outwritef(nb, "nanabozo_n += nanabozo_format_%c(nanabozo_o"
+                        " + nanabozo_n, nanabozo_a%lu);\n", pc->conv,
+                        (unsigned long) k++);
+            }
+        }
+        if (nb->opts.sized && !nb->opts.writev) {
+            outwritef(nb, "%s(nanabozo_o, nanabozo_n); }\n", nb->print_n);
+        }
+        else {
+            /* the buffer is copied */
+            outwritef(nb, "nanabozo_o[nanabozo_n] = '\\0';\n%s(nanabozo_o); }\n",
+                    nb->print);
+        }
+    }
+    outwrite(nb, "}", 1);
+    return 1;
+}
+static const char *format_type( const char *mod, const size_t len,
+        const int conv )
+{
+    static const char *const mods[] = { "", "hh", "h", "l", "ll", "z" };
+    static const char *const signed_types[] = { "int ", "signed char ",
+        "short ", "long ", "long long ", NULL };
+    static const char *const unsigned_types[] = { "unsigned int ",
+        "unsigned char ", "unsigned short ", "unsigned long ",
+        "unsigned long long ", "size_t " };
+    size_t i;
+
+    for (i = 0; i < 6; i++) {
+        if (strlen(mods[i]) == len && !memcmp(mods[i], mod, len)) {
+            break;
+        }
+    }
+    switch (conv) {
+    case 'd':
+    case 'i':
+        return i < 6 ? signed_types[i] : NULL;
+    case 'u':
+    case 'x':
+        return i < 6 ? unsigned_types[i] : NULL;
+    case 's':
+        return !len ? "const char *" : NULL;
+    case 'c':
+        return !len ? "int " : NULL;
+    }
+    return NULL;
+}
+static const char *skip_c_literal( const char *p, const char *end )
+{
+    const char quote = *p++;
+    for (; p != end && *p != quote; p++) {
+        if (*p == '\n' || (*p == '\\' && ++p == end)) {
+            return NULL;
+        }
+    }
+    return p != end ? p + 1 : NULL;
+}
+static void bad_escape_start( struct nanabozo *nb, const struct match *mt )
+{
+    (void) mt;
+    stop(nb, NANABOZO_ESCRIPT, "escaped value in unquoted attribute");
+}
+static void bad_tag_end( struct nanabozo *nb, const struct match *mt )
+{
+    (void) mt;
+    stop(nb, NANABOZO_ESCRIPT, "special char '>' => '&gt;' ?");
+}
+static void bad_tag_start( struct nanabozo *nb, const struct match *mt )
+{
+    (void) mt;
+    stop(nb, NANABOZO_ESCRIPT, "special char '<' => '&lt;' ?");
+}
+static void c_dquote_start( struct nanabozo *nb, const struct match *mt )
+{
+    outwrite(nb, nb->q, mt->len);
+    nb->q += mt->len;
+    nb->q_len -= mt->len;
+    eat_c_dquote(nb);
+}
+static void c_end( struct nanabozo *nb, const struct match *mt )
+{
+    if (!nb->opts.no_comments) {
+        outwritef(nb, "/* END C (line %lu) */", nb->lineno);
+    }
+    nb->q += mt->len;
+    nb->q_len -= mt->len;
+    nb->context = &nb->html_matcher;
+    nb->context_fallback = &html_fallback;
+}
+static void c_escape_start( struct nanabozo *nb, const struct match *mt )
+{
+    nb->q += mt->len;
+    nb->q_len -= mt->len;
+    c_escape_string(nb, "html");
+}
+static void c_escape_string( struct nanabozo *nb, const char *escaper )
+{
+    bufout(nb);
+    if (!nb->opts.no_comments) {
+        outwritef(nb, "/* BEGIN C- (line %lu) */\n", nb->lineno);
+    }
+    if (nb->opts.profile_regions) {
+        profile_begin(nb, "C-", nb->lineno);
+    }
+    outwrites(nb, ESCAPE_START);
+    eat_c_argument(nb);
+    if (nb->opts.sized && !nb->opts.writev) {
+        outwritef(nb, ESCAPE_STOP_N, escaper, nb->print_n);
+    }
+    else {
+        /* escaped chunks are copied */
+        outwritef(nb, ESCAPE_STOP, escaper, nb->print);
+    }
+    if (nb->opts.profile_regions) {
+        profile_end(nb);
+    }
+    if (!nb->opts.no_comments) {
+        outwritef(nb, "\n/* END C- (line %lu) */", nb->lineno);
+    }
+}
+static void c_macro_start( struct nanabozo *nb, const struct match *mt )
+{
+    if (nb->include) {
+        scan_include(nb);
+    }
+    outwrite(nb, nb->q, mt->len);
+    nb->q += mt->len;
+    nb->q_len -= mt->len;
+    eat_c_macro(nb);
+}
+static void c_ml_comment_start( struct nanabozo *nb, const struct match *mt )
+{
+    outwrite(nb, nb->q, mt->len);
+    nb->q += mt->len;
+    nb->q_len -= mt->len;
+    eat_c_ml_comment(nb);
+}
+static void c_sl_comment_start( struct nanabozo *nb, const struct match *mt )
+{
+    outwrite(nb, nb->q, mt->len);
+    nb->q += mt->len;
+    nb->q_len -= mt->len;
+    eat_c_sl_comment(nb);
+}
+static void c_squote_start( struct nanabozo *nb, const struct match *mt )
+{
+    outwrite(nb, nb->q, mt->len);
+    nb->q += mt->len;
+    nb->q_len -= mt->len;
+    eat_c_squote(nb);
+}
+static void c_start( struct nanabozo *nb, const struct match *mt )
+{
+    bufout(nb);
+    if (!nb->opts.no_comments) {
+        outwritef(nb, "/* BEGIN C (line %lu) */\n", nb->lineno);
+    }
+    nb->q += mt->len;
+    nb->q_len -= mt->len;
+    nb->context = &nb->c_matcher;
+    nb->context_fallback = &c_fallback;
+}
+static void c_print_format_start( struct nanabozo *nb,
+        const struct match *mt )
+{
+    bufout(nb);
+    if (!nb->opts.no_comments) {
+        outwritef(nb, "/* BEGIN C%% (line %lu) */\n", nb->lineno);
+    }
+    if (nb->opts.profile_regions) {
+        profile_begin(nb, "C%", nb->lineno);
+    }
+    nb->q += mt->len;
+    nb->q_len -= mt->len;
+    if (!nb->opts.compile_formats || !compile_format(nb)) {
+        eat_c_print_format(nb);
+    }
+    if (nb->opts.profile_regions) {
+        profile_end(nb);
+    }
+    if (!nb->opts.no_comments) {
+        outwritef(nb, "\n/* END C%% (line %lu) */", nb->lineno);
+    }
+}
+static void c_print_number( struct nanabozo *nb, const int conv )
+{
+    bufout(nb);
+    if (!nb->opts.no_comments) {
+        outwritef(nb, "/* BEGIN C%%%c (line %lu) */\n", conv, nb->lineno);
+    }
+    if (nb->opts.profile_regions) {
+        const char kind[4] = { 'C', '%', (char) conv, '\0' };
+        profile_begin(nb, kind, nb->lineno);
+    }
+    if (nb->opts.sized && !nb->opts.writev) {
+        outwritef(nb, NUMBER_START_N, nb->print_n, conv,
+                conv == 'd' ? "" : NUMBER_UNSIGNED);
+        eat_c_argument(nb);
+        outwrites(nb, NUMBER_STOP_N);
+    }
+    else {
+        /* digits are copied */
+        outwritef(nb, NUMBER_START, conv,
+                conv == 'd' ? "" : NUMBER_UNSIGNED);
+        eat_c_argument(nb);
+        outwritef(nb, NUMBER_STOP, nb->print);
+    }
+    if (nb->opts.profile_regions) {
+        profile_end(nb);
+    }
+    if (!nb->opts.no_comments) {
+        outwritef(nb, "\n/* END C%%%c (line %lu) */", conv, nb->lineno);
+    }
+}
+static void c_print_number_start( struct nanabozo *nb,
+        const struct match *mt )
+{
+    const int conv = nb->q[3];
+    nb->q += mt->len;
+    nb->q_len -= mt->len;
+    c_print_number(nb, conv);
+}
+static void c_print_start( struct nanabozo *nb, const struct match *mt )
+{
+    bufout(nb);
+    if (!nb->opts.no_comments) {
+        outwritef(nb, "/* BEGIN C= (line %lu) */\n", nb->lineno);
+    }
+    if (nb->opts.profile_regions) {
+        profile_begin(nb, "C=", nb->lineno);
+    }
+    nb->q += mt->len;
+    nb->q_len -= mt->len;
+    eat_c_print_string(nb);
+    if (nb->opts.profile_regions) {
+        profile_end(nb);
+    }
+    if (!nb->opts.no_comments) {
+        outwritef(nb, "\n/* END C= (line %lu) */", nb->lineno);
+    }
+}
+static void html_comment_start( struct nanabozo *nb, const struct match *mt )
+{
+    /* conditional comments (<!--[if ...]>), and those of <pre> and
+       <textarea>, are kept */
+    const int keep = !nb->opts.minify || nb->verbatim
+        || (nb->q_len > mt->len && nb->q[mt->len] == '[');
+
+    if (keep) {
+        bufwrite(nb, nb->q, mt->len);
+    }
+    nb->q += mt->len;
+    nb->q_len -= mt->len;
+    eat_html_comment(nb, keep);
+}
+static void partial_start( struct nanabozo *nb, const struct match *mt )
+{
+    const char *name, *p;
+    size_t len;
+
+    if (!nb->partial) {
+        stop(nb, NANABOZO_ESCRIPT, "partials are not enabled");
+    }
+    if (!(p = partial_name(nb->q + mt->len, nb->eol, &name, &len))) {
+        stop(nb, NANABOZO_ESCRIPT, "bad include, <?include \"name\" ?>");
+    }
+    bufout(nb);
+    if (!nb->opts.no_comments) {
+        outwritef(nb, "/* BEGIN INCLUDE \"%.*s\" (line %lu) */\n",
+                (int) len, name, nb->lineno);
+    }
+    if (nb->scanned) {
+        /* partial in a partial, spliced when output */
+        add_splice(nb, nb->scanned, name, len);
+    }
+    else {
+        splice_partial(nb, check_partial(nb, name, len, 0, 0));
+    }
+    if (!nb->opts.no_comments) {
+        outwritef(nb, "\n/* END INCLUDE \"%.*s\" (line %lu) */",
+                (int) len, name, nb->lineno);
+    }
+    /* and the newline after, like ?> */
+    if (nb->eol - p >= 2 && p[0] == '\r' && p[1] == '\n') {
+        p += 2;
+    }
+    else if (p != nb->eol && *p == '\n') {
+        p++;
+    }
+    nb->q_len -= (size_t) (p - nb->q);
+    nb->q = p;
+}
+static void script_bquote_start( struct nanabozo *nb,
+        const struct match *mt )
+{
+    bufwrite(nb, nb->q, mt->len);
+    nb->q += mt->len;
+    nb->q_len -= mt->len;
+    eat_script_bquote(nb);
+}
+static void script_dquote_start( struct nanabozo *nb,
+        const struct match *mt )
+{
+    bufwrite(nb, nb->q, mt->len);
+    nb->q += mt->len;
+    nb->q_len -= mt->len;
+    eat_script_dquote(nb);
+}
+static void script_ml_comment_start( struct nanabozo *nb,
+        const struct match *mt )
+{
+    if (!nb->opts.minify) {
+        bufwrite(nb, nb->q, mt->len);
+    }
+    nb->q += mt->len;
+    nb->q_len -= mt->len;
+    eat_script_ml_comment(nb, !nb->opts.minify);
+}
+static void script_sl_comment_start( struct nanabozo *nb,
+        const struct match *mt )
+{
+    if (!nb->opts.minify) {
+        bufwrite(nb, nb->q, mt->len);
+    }
+    nb->q += mt->len;
+    nb->q_len -= mt->len;
+    eat_script_sl_comment(nb, !nb->opts.minify);
+}
+static void script_squote_start( struct nanabozo *nb,
+        const struct match *mt )
+{
+    bufwrite(nb, nb->q, mt->len);
+    nb->q += mt->len;
+    nb->q_len -= mt->len;
+    eat_script_squote(nb);
+}
+static void script_end( struct nanabozo *nb, const struct match *mt )
+{
+    bufwrite(nb, nb->q, mt->len);
+    nb->q += mt->len;
+    nb->q_len -= mt->len;
+    nb->context = &nb->html_matcher;
+    nb->context_fallback = &html_fallback;
+}
+static void script_escape_start( struct nanabozo *nb,
+        const struct match *mt )
+{
+    /* value as a javascript string */
+    bufput(nb, '"');
+    nb->q += mt->len;
+    nb->q_len -= mt->len;
+    c_escape_string(nb, "js");
+    bufput(nb, '"');
+}
+static void script_start( struct nanabozo *nb, const struct match *mt )
+{
+    bufwrite(nb, nb->q, mt->len);
+    nb->q += mt->len;
+    nb->q_len -= mt->len;
+    nb->context = &nb->script_matcher;
+    nb->context_fallback = &html_fallback;
+}
+static void style_end( struct nanabozo *nb, const struct match *mt )
+{
+    bufwrite(nb, nb->q, mt->len);
+    nb->q += mt->len;
+    nb->q_len -= mt->len;
+    nb->context = &nb->html_matcher;
+    nb->context_fallback = &html_fallback;
+}
+static void style_ml_comment_start( struct nanabozo *nb,
+        const struct match *mt )
+{
+    if (!nb->opts.minify) {
+        bufwrite(nb, nb->q, mt->len);
+    }
+    nb->q += mt->len;
+    nb->q_len -= mt->len;
+    eat_script_ml_comment(nb, !nb->opts.minify);
+}
+static void style_start( struct nanabozo *nb, const struct match *mt )
+{
+    bufwrite(nb, nb->q, mt->len);
+    nb->q += mt->len;
+    nb->q_len -= mt->len;
+    nb->context = &nb->style_matcher;
+    nb->context_fallback = &html_fallback;
+}
+static void tag_dquote_start( struct nanabozo *nb, const struct match *mt )
+{
+    bufwrite(nb, nb->q, mt->len);
+    nb->q += mt->len;
+    nb->q_len -= mt->len;
+    nb->value_escaper = value_escaper(nb);
+    eat_script_dquote(nb);
+}
+static void tag_end( struct nanabozo *nb, const struct match *mt )
+{
+    bufwrite(nb, nb->q, mt->len);
+    nb->q += mt->len;
+    nb->q_len -= mt->len;
+    nb->context = &nb->html_matcher;
+    nb->context_fallback = &html_fallback;
+}
+static void tag_squote_start( struct nanabozo *nb, const struct match *mt )
+{
+    bufwrite(nb, nb->q, mt->len);
+    nb->q += mt->len;
+    nb->q_len -= mt->len;
+    nb->value_escaper = value_escaper(nb);
+    eat_script_squote(nb);
+}
+static void tag_start( struct nanabozo *nb, const struct match *mt )
+{
+    if (nb->opts.minify) {
+        minify_tag(nb);
+    }
+    bufwrite(nb, nb->q, mt->len);
+    nb->q += mt->len;
+    nb->q_len -= mt->len;
+    nb->context = &nb->tag_matcher;
+    nb->context_fallback = &html_fallback;
+}
+static void eat_c_argument( struct nanabozo *nb )
+{
+    int i, j = 0;
+    while (j || (i = cursor(nb)) != EOF) {
+        if (j) {
+            i = j;
+            j = 0;
+        }
+        switch (i) {
+        case '"':
+            /* dquote string begins */
+            output(nb, i);
+            eat_c_dquote(nb);
+            continue;
+        case '\'':
+            /* squote char begins */
+            output(nb, i);
+            eat_c_squote(nb);
+            continue;
+        case '?':
+            switch ((j = cursor(nb))) {
+            case EOF:
+                stop(nb, NANABOZO_ESCRIPT,
+                        "eof while scanning C print-string arguments");
+                return;
+            case '>':
+                /* end tag */
+                return;
+            }
+        }
+        output(nb, i);
+    }
+    stop(nb, NANABOZO_ESCRIPT, "eof while scanning C print-string arguments");
+}
+static void eat_c_dquote( struct nanabozo *nb )
+{
+    int i, prev = -1;
+    while ((i = cursor(nb)) != EOF) {
+        if (i == '\n') {
+            stop(nb, NANABOZO_ESCRIPT,
+                    "unexpected newline in C double-quoted string");
+        }
+        output(nb, i);
+        if (i == '"' && prev != '\\') {
+            return;
+        }
+        prev = i;
+    }
+    stop(nb, NANABOZO_ESCRIPT, "eof while scanning C double-quoted string");
+}
+static void eat_c_macro( struct nanabozo *nb )
+{
+    int i, j = 0, prev = -1;
+    while (j || (i = cursor(nb)) != EOF) {
+        if (j) {
+            i = j;
+            j = 0;
+        }
+        switch (i) {
+        case '"':
+            /* dquote string begins */
+            output(nb, i);
+            eat_c_dquote(nb);
+            prev = -1;
+            continue;
+        case '\'':
+            /* squote char begins */
+            output(nb, i);
+            eat_c_squote(nb);
+            prev = -1;
+            continue;
+        case '/':
+            switch ((j = cursor(nb))) {
+            case EOF:
+                stop(nb, NANABOZO_ESCRIPT, "eof while scanning C macro");
+                return;
+            case '*':
+                /* ml comment begins */
+                outwrite(nb, "/*", 2);
+                eat_c_ml_comment(nb);
+                return;
+            case '/':
+                /* sl comment begins */
+                outwrite(nb, "//", 2);
+                eat_c_sl_comment(nb);
+                return;
+            }
+        }
+        output(nb, i);
+        if (i == '\n' && prev != '\\') {
+            /* end of macro */
+            return;
+        }
+        prev = i;
+    }
+    stop(nb, NANABOZO_ESCRIPT, "eof while scanning C macro");
+}
+static void eat_c_print_format( struct nanabozo *nb )
+{
+    int i, j = 0;
+    outwritef(nb, "%s(", nb->printf);
+    while (j || (i = cursor(nb)) != EOF) {
+        if (j) {
+            i = j;
+            j = 0;
+        }
+        switch (i)
+        {
+        case '"':
+            /* dquote string begins */
+            output(nb, i);
+            eat_c_dquote(nb);
+            continue;
+        case '\'':
+            /* squote char begins */
+            output(nb, i);
+            eat_c_squote(nb);
+            continue;
+        case '?':
+            switch ((j = cursor(nb))) {
+            case EOF:
+                stop(nb, NANABOZO_ESCRIPT,
+                        "eof while scanning C print-formatted arguments");
+                return;
+            case '>':
+                /* end tag */
+                outwrite(nb, ");", 2);
+                return;
+            default:
+                output(nb, '?');
+                continue;
+            }
+        }
+        output(nb, i);
+    }
+    stop(nb, NANABOZO_ESCRIPT,
+            "eof while scanning C print-formatted arguments");
+}
+static void eat_c_print_string( struct nanabozo *nb )
+{
+    outwritef(nb, "%s(", nb->print);
+    eat_c_argument(nb);
+    outwrite(nb, ");", 2);
+}
+static void eat_c_ml_comment( struct nanabozo *nb )
+{
+    int i, prev = -1;
+    while ((i = cursor(nb)) != EOF) {
+        output(nb, i);
+        if (i == '/' && prev == '*') {
+            /* end of comment */
+            return;
+        }
+        prev = i;
+    }
+    stop(nb, NANABOZO_ESCRIPT, "eof while scanning C multi-line comment");
+}
+static void eat_c_sl_comment( struct nanabozo *nb )
+{
+    int i;
+    while ((i = cursor(nb)) != EOF) {
+        output(nb, i);
+        if (i == '\n') {
+            /* end of comment */
+            return;
+        }
+    }
+    stop(nb, NANABOZO_ESCRIPT, "eof while scanning C single-line comment");
+}
+static void eat_c_squote( struct nanabozo *nb )
+{
+    int i, j = 0;
+    while ((i = cursor(nb)) != EOF) {
+        switch (j) {
+        case 0:
+            switch (i) {
+            case '\'':
+            case '\n':
+                /* invalid chars, etc todo */
+                stop(nb, NANABOZO_ESCRIPT, "invalid C single-quoted char");
+            }
+            output(nb, i);
+            if (i == '\\') {
+                j++;
+                continue;
+            }
+            else {
+                j += 2;
+                continue;
+            }
+        case 1:
+            output(nb, i);
+            j++;
+            continue;
+        case 2:
+            /* expecting single quote */
+            if (i != '\'') {
+                stop(nb, NANABOZO_ESCRIPT, "invalid C single-quoted char");
+            }
+            output(nb, i);
+            return;
+        }
+    }
+    stop(nb, NANABOZO_ESCRIPT, "eof while scanning C single-quoted char");
+}
+static void eat_html_comment( struct nanabozo *nb, const int keep )
+{
+    int i, prev = -1, prev1 = -1;
+    while ((i = cursor(nb)) != EOF) {
+        if (keep) {
+            bufput(nb, i);
+        }
+        if (i == '>' && prev == '-' && prev1 == '-') {
+            /* end of comment */
+            return;
+        }
+        prev1 = prev;
+        prev = i;
+    }
+    stop(nb, NANABOZO_ESCRIPT, "eof while scanning html comment");
+}
+static void eat_script_bquote( struct nanabozo *nb )
+{
+    int i, prev = -1;
+    while ((i = cursor(nb)) != EOF) {
+        if (string_tag_start(nb, i)) {
+            prev = -1;
+            continue;
+        }
+        bufput(nb, i);
+        if (i == '`' && prev != '\\') {
+            /* end of template string */
+            return;
+        }
+        prev = prev == '\\' ? -1 : i;
+    }
+    stop(nb, NANABOZO_ESCRIPT,
+            "eof while scanning script template string");
+}
+static void eat_script_dquote( struct nanabozo *nb )
+{
+    int i, prev = -1;
+    while ((i = cursor(nb)) != EOF) {
+        if (i == '\n') {
+            stop(nb, NANABOZO_ESCRIPT,
+                    "unexpected newline in script double-quoted string");
+        }
+        if (string_tag_start(nb, i)) {
+            prev = -1;
+            continue;
+        }
+        bufput(nb, i);
+        if (i == '"' && prev != '\\') {
+            /* end of string */
+            return;
+        }
+        prev = i;
+    }
+    stop(nb, NANABOZO_ESCRIPT,
+            "eof while scanning script double-quoted string");
+}
+static void eat_script_ml_comment( struct nanabozo *nb, const int keep )
+{
+    int i, prev = -1;
+    while ((i = cursor(nb)) != EOF) {
+        if (keep) {
+            bufput(nb, i);
+        }
+        if (i == '/' && prev == '*') {
+            /* end of comment, a space when dropped */
+            if (!keep && (!nb->buf_len
+                    || !isspace((unsigned char) nb->buf[nb->buf_len - 1])))
+            {
+                minify_write(nb, " ", 1);
+            }
+            return;
+        }
+        prev = i;
+    }
+    stop(nb, NANABOZO_ESCRIPT,
+            "eof while scanning script multi-line comment");
+}
+static void eat_script_sl_comment( struct nanabozo *nb, const int keep )
+{
+    int i;
+    while ((i = cursor(nb)) != EOF) {
+        if (keep) {
+            bufput(nb, i);
+        }
+        if (i == '\n') {
+            /* end of comment, the newline is kept */
+            if (!keep) {
+                minify_write(nb, "\n", 1);
+            }
+            return;
+        }
+    }
+    stop(nb, NANABOZO_ESCRIPT,
+            "eof while scanning script single-line comment");
+}
+static void eat_script_squote( struct nanabozo *nb )
+{
+    int i, prev = -1;
+    while ((i = cursor(nb)) != EOF) {
+        if (i == '\n') {
+            stop(nb, NANABOZO_ESCRIPT,
+                    "unexpected newline in script single-quoted string");
+        }
+        if (string_tag_start(nb, i)) {
+            prev = -1;
+            continue;
+        }
+        bufput(nb, i);
+        if (i == '\'' && prev != '\\') {
+            /* end of string */
+            return;
+        }
+        prev = i;
+    }
+    stop(nb, NANABOZO_ESCRIPT,
+            "eof while scanning script single-quoted string");
+}
+static void stop( struct nanabozo *nb, const int err, const char *msg )
+{
+    if (!nb->stopping) {
+        nb->stopping = err;
+        if (nb->includer) {
+            snprintf(nb->errmsg, sizeof(nb->errmsg), "%s (in partial '%s')",
+                    msg, nb->includer->name);
+        }
+        else {
+            snprintf(nb->errmsg, sizeof(nb->errmsg), "%s", msg);
+        }
+        if (nb->scanned) {
+            /* its code is dropped, scanned again next time */
+            reset_partial(nb->scanned);
+            nb->write = nb->scanned_write;
+            nb->write_arg = nb->scanned_write_arg;
+            nb->scanned = NULL;
+            nb->out_len = 0;
+            nb->buf_len = 0;
+        }
+        /* send what we have, best effort */
+        bufout(nb);
+        outflush(nb);
+    }
+    longjmp(nb->env, 1);
+}
+static void stop2( struct nanabozo *nb, const int err, const char *fmt, ... )
+{
+    char msg[1024];
+    va_list ap;
+    va_start(ap, fmt);
+    vsnprintf(msg, sizeof(msg), fmt, ap);
+    va_end(ap);
+    stop(nb, err, msg);
+}
+
+/* vi: set fenc=utf-8 ff=unix sw=4 ts=4 sts=4 et ai : */
@@ -17,23 +17,36 @@
 
 */
 
-#include <assert.h>
-#include <ctype.h>
+#include <errno.h>
 #include <getopt.h>
+#include <setjmp.h>
 #include <stdarg.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <time.h>
 
-#ifndef INPUTSIZE
-#define INPUTSIZE 512
+#ifdef __linux__
+#include <sys/inotify.h>
 #endif
 
-#ifdef _MSC_VER
-#ifndef PAGESIZE
-#define PAGESIZE 128
+#ifndef _MSC_VER
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#else
+#include <direct.h>
+#include <process.h>
+#define getpid _getpid
+#define mkdir(path, mode) _mkdir(path)
 #endif
+
+#include "nanabozo.h"
+
+#ifndef READSIZE
+#define READSIZE 65536
 #endif
 
 #ifndef VERSION_STR
@@ -54,11 +67,44 @@ static const char _usage[] =
 "    See the GNU General Public License for more details.\n"
 "\n"
 "Usage: nanabozo [OPTIONS...] [(inputfile|-) [(outputfile|-)]]\n"
+"       nanabozo [OPTIONS...] -o <output> [-i <manifest>] [inputfile...]\n"
 "\n"
 "Options:\n"
 "  -m, --main           Turn input into the body of an implicit main function.\n"
 "  -t, --html           Print content-type header (text/html, charset utf-8).\n"
 "  -n, --no-comments    Omit all begin/end comments in output.\n"
+"  -x, --minify         Drop html comments, script and style comments, and\n"
+"                       collapse spaces in html (not in <pre>, <textarea>\n"
+"                       or quoted strings).\n"
+"  -C, --compile-formats\n"
+"                       Split literal printf formats at translation time\n"
+"                       into print calls and number writers\n"
+"                       (nanabozo_format.h), when simple enough.\n"
+"  -l, --line-buffered  Flush output at each newline (interactive use).\n"
+"  -o <output>, --output=<output>   Batch mode, translate all input files.\n"
+"                       Output is a directory (file.php => output/file.c),\n"
+"                       or a pattern where %s is the input base name,\n"
+"                       eg. -o 'build/%s.cpp'\n"
+"  -i <manifest>, --manifest=<manifest>   Batch mode, read input files from\n"
+"                       manifest, one per line ('-' for stdin).\n"
+"  -j <jobs>, --jobs=<jobs>   Batch mode, number of parallel jobs.\n"
+"                       Defaults to the number of processors.\n"
+"  -d, --deterministic  Omit the date from the top comment (generated by),\n"
+"                       so that output only depends on input and options.\n"
+"  -k <dir>, --cache=<dir>  Keep translations in cache directory, keyed by\n"
+"                       input and options, and skip translating on a hit.\n"
+"                       Implies --deterministic.\n"
+"  -M <depfile>, --depfile=<depfile>    Write make dependencies on files\n"
+"                       included (#include \"...\") in C code, and partials.\n"
+"                       In batch mode, a directory or pattern, as with -o.\n"
+"  -T <target>, --dep-target=<target>   Target of the dependencies rule.\n"
+"                       Defaults to the output file.\n"
+"  -I <dir>, --include-dir=<dir>    Search included files in directory.\n"
+"                       Included files and partials are searched relative\n"
+"                       to the script first, then in include dirs.\n"
+"  -w, --watch          Batch mode, keep running and translate again the\n"
+"                       input files when they, or files they include,\n"
+"                       change (linux only).\n"
 "  -c <comment>, --comment=<comment>    Override top comment (generated by).\n"
 "                       Pass an empty string to omit comment header.\n"
 "  -a <prefix>, --prepend=<prefix>  String (prefix) to prepend.\n"
@@ -71,6 +117,37 @@ static const char _usage[] =
 "  -p <func>, --print=<func>    Override the name of function 'print(x)'.\n"
 "                       By default, 'print(x)' is a macro for 'fputs(x, stdout)'.\n"
 "  -f <func>, --printf=<func>   Override the name of function 'printf(x, ...)'.\n"
+"  -s, --sized          Pass the length of html strings, with 'print_n(x, n)',\n"
+"                       so that they are not measured at runtime.\n"
+"                       By default, 'print_n' is a macro for 'fwrite', or\n"
+"                       the name of function 'print' followed by '_n'.\n"
+"  -P <func>, --print-n=<func>  Override the name of function 'print_n(x, n)'.\n"
+"                       Implies --sized.\n"
+"  -W, --writev         Collect the output of print, print_n and printf in an\n"
+"                       iovec, written with 'writev' at exit or 'print_flush()'.\n"
+"                       Html strings are not copied. Implies --sized.\n"
+"  -b, --buffer         Build the page in a response buffer (nanabozo_buffer.h),\n"
+"                       sent at exit or 'print_flush()'. Headers given to\n"
+"                       'print_header(x)' (and --html) get a Content-Length.\n"
+"                       Implies --sized.\n"
+"  -F, --fastcgi        Turn input into the body of a FastCGI request loop\n"
+"                       (nanabozo_fastcgi.h), printing to a response buffer\n"
+"                       as with --buffer. Implies --sized.\n"
+"  -X[<name>], --cxx[=<name>]\n"
+"                       Turn input into the body of a C++ function template\n"
+"                       over its output sink (nanabozo_cxx.h, C++17), named\n"
+"                       'nanabozo_page' by default. With --main, main renders\n"
+"                       it to stdout. Implies --sized.\n"
+"  -S[<format>], --stats[=<format>]\n"
+"                       Report counters and times of the translator on stderr,\n"
+"                       for each script translated: bytes by context, matches,\n"
+"                       lines, html regions, output writes, time by phase.\n"
+"                       Format is 'text' (default) or 'json' (one line).\n"
+"  -R, --profile-regions\n"
+"                       Time each html string and each print tag of the\n"
+"                       page (nanabozo_profile.h), keyed by file and line,\n"
+"                       and dump calls and ticks at exit, on stderr or to\n"
+"                       the file named by NANABOZO_PROFILE.\n"
 "  -v, --version        Print version information and exit.\n"
 "  -h, --help           Print usage information and exit.\n"
 "\n"
@@ -101,139 +178,181 @@ static const char _version[] =
 
 #define COMPILED_WITH \
     "Compiled " __DATE__ " " __TIME__ " with:\n" \
-    "    INPUTSIZE=(%d)\n" \
+    "    READSIZE=(%d)\n" \
+    "    OUTSIZE=(%d)\n" \
     "\n"
 
-struct match
-{
-    char *str;
-    size_t len;
-    void (*hook)( struct match *mt );
-    char* p; /* search result */
-};
-
-void proceed( void );
-size_t read_input( void );
-struct match *context_match( void );
-void reset_context( struct match *mt );
-int valid_identifier( const char* id );
+void translate( void );
+void reset_state( void );
+void add_input( char *fpath );
+void read_manifest( const char *fpath );
+int output_path( char *dst, const size_t sz, const char *pattern,
+        const char *input, const char *ext );
+void check_outputs( void );
+int cmp_outputs( const void *a, const void *b );
+int batch( void );
+int batch_worker( const size_t first, const size_t step );
+int batch_file( const size_t i );
+FILE *open_output( const char *fpath );
+int close_output( const char *fpath );
+void discard_output( void );
+int same_content( const char *fpath1, const char *fpath2 );
+int write_output( void *arg, const char *s, size_t len );
+int cache_fetch( void );
+void cache_store( void );
+void cache_discard( void );
+uint64_t hash_bytes( uint64_t h, const void *p, const size_t len );
+uint64_t hash_str( uint64_t h, const char *s );
+void add_include_dir( char *dir );
+int record_include( void *arg, const char *name, size_t len );
+void clear_includes( void );
+int resolve_include( char *dst, const size_t sz, const char *name );
+int load_partial( void *arg, const char *name, size_t len,
+        const char **src, size_t *srclen );
+void clear_partials( void );
+int cache_partials( void );
+int write_depfile( const char *depfile, const char *target );
+void dep_escape( FILE *f, const char *s );
+#ifdef __linux__
+int watch( void );
+void watch_input( const int fd, const size_t i );
+void watch_file( const int fd, const char *fpath, const size_t i );
+void unwatch_input( const size_t i );
+#endif
+void load_input( void );
+void unload_input( void );
 int valid_filepath( const char* fpath );
 
-void bufwrite( const char *s, const size_t len );
-void bufout( void );
-void bufput( const int c );
-void write( const char *s, const size_t len );
-void put( const int c );
-int cursor( void );
-
-void c_fallback( const char *eol );
-void html_fallback( const char *eol );
-
-void bad_tag_end( struct match *mt );
-void bad_tag_start( struct match *mt );
-void c_dquote_start( struct match *mt );
-void c_end( struct match *mt );
-void c_macro_start( struct match *mt );
-void c_ml_comment_start( struct match *mt );
-void c_print_format_start( struct match *mt );
-void c_print_start( struct match *mt );
-void c_sl_comment_start( struct match *mt );
-void c_squote_start( struct match *mt );
-void c_start( struct match *mt );
-void eat_c_dquote( void );
-void eat_c_macro( void );
-void eat_c_ml_comment( void );
-void eat_c_print_format( void );
-void eat_c_print_string( void );
-void eat_c_sl_comment( void );
-void eat_c_squote( void );
-void eat_html_comment( void );
-void eat_script_dquote( void );
-void eat_script_ml_comment( void );
-void eat_script_sl_comment( void );
-void eat_script_squote( void );
-void html_comment_start( struct match *mt );
-void script_dquote_start( struct match *mt );
-void script_end( struct match *mt );
-void script_ml_comment_start( struct match *mt );
-void script_sl_comment_start( struct match *mt );
-void script_squote_start( struct match *mt );
-void script_start( struct match *mt );
-void style_end( struct match *mt );
-void style_ml_comment_start( struct match *mt );
-void style_start( struct match *mt );
-void tag_dquote_start( struct match *mt );
-void tag_end( struct match *mt );
-void tag_squote_start( struct match *mt );
-void tag_start( struct match *mt );
+void report_stats( void );
+void report_cached( void );
+void report_add( char *buf, const size_t sz, size_t *len,
+        const char *fmt, ... );
+void report_escape( char *dst, const size_t sz, const char *s );
+double wall_clock( void );
 
 void stop( const char *msg );
 void stop2( const char *fmt, ... );
+void stopped( const char *msg );
 
-/* options */
-int _do_mainfunc = 0;   /* option --main */
-int _do_send_headers = 0;   /* option --html */
-char *_m_comment = NULL;    /* option --comment */
-char *_m_prefix = NULL;     /* option --prepend */
-char *_m_print = NULL;  /* option --print */
-char *_m_printf = NULL; /* option --printf */
-char *_m_suffix = NULL; /* option --append */
-int _no_comments = 0;   /* option --no-comments */
-int _print_given = 0;
-int _printf_given = 0;
+/* translation options */
+struct nanabozo_options _opts;
+/* translator */
+struct nanabozo *_nb = NULL;
+/* other options */
+char *_m_output_pattern = NULL;   /* option --output */
+char *_m_manifest = NULL;   /* option --manifest */
+long _jobs = 0; /* option --jobs */
+char *_m_cache = NULL;  /* option --cache */
+char *_m_depfile = NULL;    /* option --depfile */
+char *_m_dep_target = NULL; /* option --dep-target */
+/* option --include-dir */
+char **_m_include_dirs = NULL;
+size_t _m_include_dirs_len = 0;
+int _watch = 0; /* option --watch */
+int _stats = 0; /* option --stats, STATS_TEXT or STATS_JSON */
 /* arguments */
 char *_m_input_file = NULL;
 char *_m_output_file = NULL;
+/* batch mode input files */
+char **_m_inputs = NULL;
+size_t _m_inputs_len = 0;
+size_t _m_inputs_sz = 0;
+char *_manifest_buf = NULL;
 
 static struct option _long_options[] =
 {
     {"append",      required_argument,  0,  'z'},
+    {"buffer",      no_argument,        0,  'b'},
+    {"cache",       required_argument,  0,  'k'},
     {"comment",     required_argument,  0,  'c'},
+    {"compile-formats", no_argument,    0,  'C'},
+    {"cxx",         optional_argument,  0,  'X'},
+    {"dep-target",  required_argument,  0,  'T'},
+    {"depfile",     required_argument,  0,  'M'},
+    {"deterministic", no_argument,      0,  'd'},
+    {"fastcgi",     no_argument,        0,  'F'},
     {"help",        no_argument,        0,  'h'},
     {"html",        no_argument,        0,  't'},
+    {"include-dir", required_argument,  0,  'I'},
+    {"jobs",        required_argument,  0,  'j'},
+    {"line-buffered", no_argument,      0,  'l'},
     {"main",        no_argument,        0,  'm'},
+    {"manifest",    required_argument,  0,  'i'},
+    {"minify",      no_argument,        0,  'x'},
     {"no-comments", no_argument,        0,  'n'},
+    {"output",      required_argument,  0,  'o'},
     {"prepend",     required_argument,  0,  'a'},
     {"print",       required_argument,  0,  'p'},
+    {"print-n",     required_argument,  0,  'P'},
     {"printf",      required_argument,  0,  'f'},
+    {"profile-regions", no_argument,    0,  'R'},
+    {"sized",       no_argument,        0,  's'},
+    {"stats",       optional_argument,  0,  'S'},
     {"version",     no_argument,        0,  'v'},
+    {"watch",       no_argument,        0,  'w'},
+    {"writev",      no_argument,        0,  'W'},
     {0, 0, 0, 0}
 };
 
-#define SHORT_OPTIONS "z:c:htmna:p:f:v"
+#define SHORT_OPTIONS "z:c:htmnlo:i:j:dk:M:T:I:wa:p:f:sP:WbFxCX::S::Rv"
 
-/* misc parameters */
-size_t _lineno = 0;
-int _reached_eof = 0;
+#define STATS_TEXT  1
+#define STATS_JSON  2
 
-#ifndef _MSC_VER
-#define GENERATED_BY \
-    "/*\n" \
-    " *\tGenerated by nanabozo (do not edit)\n" \
-    " *\t%a %b %d %H:%M:%S %Z %Y\n" \
-    " */\n\n"
-#else /* no %Z on windows */
-#define GENERATED_BY \
-    "/*\n" \
-    " *\tGenerated by nanabozo (do not edit)\n" \
-    " *\t%a %b %d %H:%M:%S %Y\n" \
-    " */\n\n"
-#endif
+/* time spent reading the script, for --stats */
+double _read_wall = 0;
+double _read_cpu = 0;
 
-#define _M_PRINT_DEFINE \
-    "#include <stdio.h>\n#define print(x) fputs(x, stdout)\n\n"
+/* line of last translation error */
+unsigned long _lineno = 0;
 
-#define _M_PRINTF_DEFINE \
-    "#include <stdio.h>\n\n"
+/* batch mode, file being translated */
+int _batch_file = 0;
+jmp_buf _batch_env;
+char _batch_output[4096];
 
-#define MAINFUNC_START \
-    "int main(void) {\n"
+/* files being translated */
+FILE *_in_file = NULL;
+FILE *_out_file = NULL;
+/* output file is written aside, and kept only if changed */
+char _out_tmp[4096+32];
 
-#define MAINFUNC_STOP \
-    "\nreturn 0; } /* end main function */\n"
+/* quoted includes seen in C code (for --depfile and --watch) */
+int _scan_includes = 0;
+char **_includes = NULL;
+size_t _includes_len = 0;
+size_t _includes_sz = 0;
 
-#define CONTENTTYPE_HTML \
-    "Content-Type: text/html; charset=utf-8"
+/* partials loaded for the script, as named in it */
+struct partial
+{
+    char *name;
+    char *src;
+    size_t len;
+};
+struct partial *_partials = NULL;
+size_t _partials_len = 0;
+size_t _partials_sz = 0;
+
+#ifdef __linux__
+/* watch mode, files and the input depending on them */
+struct watched
+{
+    char *dir;      /* directory watched, followed by base name */
+    char *base;
+    size_t input;
+    int wd;
+};
+struct watched *_watched = NULL;
+size_t _watched_len = 0;
+size_t _watched_sz = 0;
+#endif
+
+/* translation cache entry */
+#define HASH_INIT 14695981039346656037ULL   /* FNV-1a */
+FILE *_cache_file = NULL;
+char _cache_path[4096+32];
+char _cache_tmp[4096+64];
 
 /*
  *  Altogether, NONDIGIT DIGIT SPECIALCHAR correspond to the
@@ -250,96 +369,10 @@ int _reached_eof = 0;
 #define SPECIALCHAR \
     ".-/\\" /* underscore is in NONDIGIT */
 
-/* additional chars for c++ */
-#define CPPSPECIAL ":.-<>"
-
-/* buffer for html output */
-#ifndef _MSC_VER
-FILE *_f = NULL; /* file for open_memstream */
-#else
-char *_b;
-size_t _b_len = 0; /* length of buffer */
-#endif
-char *_buf = NULL;
-size_t _bufsz = 0;
-
-/* input buffer (line) */
-char _input[INPUTSIZE+1];
-/* always points to the end of input line */
-char *_eol = _input;
-
-/* cursor */
-char *_q = _input;
-size_t _q_len = 0;
-
-/*
- *  Context tables
- *  Longer matches must be searched first.
- */
-
-static struct match c_context[] =
-{
-    { "?>\r\n", 4, &c_end, NULL },
-    { "?>\n",   3, &c_end, NULL },
-    { "?>",     2, &c_end, NULL },
-    { "/*",     2, &c_ml_comment_start, NULL },
-    { "//",     2, &c_sl_comment_start, NULL },
-    { "\"",     1, &c_dquote_start, NULL },
-    { "'",      1, &c_squote_start, NULL },
-    { "#",      1, &c_macro_start, NULL },
-    { NULL, 0, NULL, NULL }
-};
-
-static struct match html_context[] =
-{
-    { "<script",    8, &script_start, NULL },
-    { "<SCRIPT",    8, &script_start, NULL },
-    { "<style",     7, &style_start, NULL },
-    { "<STYLE",     7, &style_start, NULL },
-    { "<!--",       4, &html_comment_start, NULL },
-    { "<?\r\n",     4, &c_start, NULL },
-    { "<?\n",       3, &c_start, NULL },
-    { "<?=",        3, &c_print_start, NULL },
-    { "<?%",        3, &c_print_format_start, NULL },
-    { "<?",         2, &c_start, NULL },
-    { "< ",         2, &bad_tag_start, NULL },
-    { "<\n",        2, &bad_tag_start, NULL },
-    { "<",          1, &tag_start, NULL },
-    { ">",          1, &bad_tag_end, NULL },
-    { NULL, 0, NULL, NULL }
-};
-
-static struct match script_context[] =
-{
-    { "</script>",  9, &script_end, NULL },
-    { "</SCRIPT>",  9, &script_end, NULL },
-    { "/*",         2, &script_ml_comment_start, NULL },
-    { "//",         2, &script_sl_comment_start, NULL },
-    { "\"",         1, &script_dquote_start, NULL },
-    { "'",          1, &script_squote_start, NULL },
-    { NULL, 0, NULL, NULL }
-};
-
-static struct match style_context[] =
-{
-    { "</style>",   8, &style_end, NULL },
-    { "</STYLE>",   8, &style_end, NULL },
-    { "/*",         2, &style_ml_comment_start, NULL },
-    { NULL, 0, NULL, NULL }
-};
-
-static struct match tag_context[] =
-{
-    { "\"",   1, &tag_dquote_start, NULL },
-    { "'",    1, &tag_squote_start, NULL },
-    { ">",    1, &tag_end, NULL },
-    { NULL, 0, NULL, NULL }
-};
-
-/* current context */
-struct match *_context = html_context;
-/* current context fallback */
-void (*_context_fallback)( const char* eol ) = &html_fallback;
+/* input buffer (whole script, mapped or read) */
+char *_src = NULL;
+size_t _src_len = 0;
+int _src_mapped = 0;
 
 int main(int argc, char *argv[])
 {
@@ -350,13 +383,13 @@ int main(int argc, char *argv[])
         if (c == -1) {
             break;
         }
-        /* "z:c:htmna:p:f:v" */
+        /* "z:c:htmnlo:i:j:dk:M:T:I:wa:p:f:sP:WbFxCX::S::Rv" */
         switch (c) {
         case 'z':
-            _m_suffix = optarg;
+            _opts.suffix = optarg;
             break;
         case 'c':
-            _m_comment = optarg;
+            _opts.comment = optarg;
             break;
         case 'h':
             if (fputs(_usage, stdout) == EOF) {
@@ -364,34 +397,118 @@ int main(int argc, char *argv[])
             }
             exit(EXIT_SUCCESS);
         case 't':
-            _do_send_headers = 1;
+            _opts.send_headers = 1;
             break;
         case 'm':
-            _do_mainfunc = 1;
+            _opts.mainfunc = 1;
             break;
         case 'n':
-            _no_comments = 1;
+            _opts.no_comments = 1;
+            break;
+        case 'l':
+            _opts.line_buffered = 1;
+            break;
+        case 'o':
+            _m_output_pattern = optarg;
+            break;
+        case 'i':
+            _m_manifest = optarg;
+            break;
+        case 'j':
+            if ((_jobs = strtol(optarg, NULL, 10)) < 1) {
+                stop2("invalid number of jobs '%s'", optarg);
+            }
+            break;
+        case 'd':
+            _opts.deterministic = 1;
+            break;
+        case 'k':
+            _m_cache = optarg;
+            if (!valid_filepath(_m_cache)) {
+                stop2("invalid argument '%s'", _m_cache);
+            }
+            _opts.deterministic = 1;
+            break;
+        case 'M':
+            _m_depfile = optarg;
+            break;
+        case 'T':
+            _m_dep_target = optarg;
+            break;
+        case 'I':
+            add_include_dir(optarg);
+            break;
+        case 'w':
+            _watch = 1;
             break;
         case 'a':
-            _m_prefix = optarg;
+            _opts.prefix = optarg;
             break;
         case 'p':
-            _m_print = optarg;
-            if (!valid_identifier(_m_print)) {
-                stop2("invalid identifier '%s'", _m_print);
+            if (!nanabozo_valid_identifier(optarg)) {
+                stop2("invalid identifier '%s'", optarg);
             }
-            _print_given = 1;
+            _opts.print = optarg;
             break;
         case 'f':
-            _m_printf = optarg;
-            if (!valid_identifier(_m_printf)) {
-                stop2("invalid identifier '%s'", _m_printf);
+            if (!nanabozo_valid_identifier(optarg)) {
+                stop2("invalid identifier '%s'", optarg);
+            }
+            _opts.printf = optarg;
+            break;
+        case 's':
+            _opts.sized = 1;
+            break;
+        case 'P':
+            if (!nanabozo_valid_identifier(optarg)) {
+                stop2("invalid identifier '%s'", optarg);
+            }
+            _opts.print_n = optarg;
+            _opts.sized = 1;
+            break;
+        case 'W':
+            _opts.writev = 1;
+            _opts.sized = 1;
+            break;
+        case 'b':
+            _opts.buffer = 1;
+            _opts.sized = 1;
+            break;
+        case 'F':
+            _opts.fastcgi = 1;
+            _opts.sized = 1;
+            break;
+        case 'x':
+            _opts.minify = 1;
+            break;
+        case 'C':
+            _opts.compile_formats = 1;
+            break;
+        case 'X':
+            if (optarg && !nanabozo_valid_identifier(optarg)) {
+                stop2("invalid identifier '%s'", optarg);
+            }
+            _opts.cxx = optarg ? optarg : "nanabozo_page";
+            _opts.sized = 1;
+            break;
+        case 'S':
+            if (!optarg || !strcmp(optarg, "text")) {
+                _stats = STATS_TEXT;
             }
-            _printf_given = 1;
+            else if (!strcmp(optarg, "json")) {
+                _stats = STATS_JSON;
+            }
+            else {
+                stop2("invalid argument '%s'", optarg);
+            }
+            _opts.stats = 1;
+            break;
+        case 'R':
+            _opts.profile_regions = 1;
             break;
         case 'v':
             if (fputs(_version, stdout) == EOF
-                || fprintf(stdout, COMPILED_WITH, INPUTSIZE) < 0)
+                || fprintf(stdout, COMPILED_WITH, READSIZE, OUTSIZE) < 0)
             {
                 stop("lost stdout");
             }
@@ -403,6 +520,29 @@ int main(int argc, char *argv[])
     } /* end getopt */
 
     /* get arguments */
+    if (_m_output_pattern) {
+        /* batch mode, all arguments are input files */
+        while (optind < argc) {
+            add_input(argv[optind++]);
+        }
+        if (_m_manifest) {
+            read_manifest(_m_manifest);
+        }
+        if (!_m_inputs_len) {
+            stop("no input files");
+        }
+    }
+    else if (_m_manifest) {
+        stop("option --manifest requires --output");
+    }
+    else if (_watch) {
+        stop("option --watch requires --output");
+    }
+#ifndef __linux__
+    if (_watch) {
+        stop("option --watch is not supported on this system");
+    }
+#endif
     while (optind < argc) {
         if (!_m_input_file) {
             _m_input_file = argv[optind++];
@@ -431,889 +571,1233 @@ int main(int argc, char *argv[])
             stop2("invalid argument '%s'", _m_output_file);
         }
     }
-    /* open files */
-    if (_m_input_file) {
-        if (!freopen(_m_input_file, "r", stdin)) {
-            stop2("unable to open '%s' for reading", _m_input_file);
+    if (_m_depfile && !_m_output_pattern) {
+        if (!valid_filepath(_m_depfile)) {
+            stop2("invalid argument '%s'", _m_depfile);
         }
-    }
-    if (_m_output_file) {
-        if (!freopen(_m_output_file, "w", stdout)) {
-            stop2("unable to open '%s' for writing", _m_output_file);
+        if (!_m_dep_target && !_m_output_file) {
+            stop("option --depfile requires an output file or --dep-target");
         }
     }
-    if (setvbuf(stdout, NULL, _IOLBF, 0) != 0) {
-        stop("unable to reset buffering");
+    if (_opts.writev && (_opts.print || _opts.printf || _opts.print_n)) {
+        stop("option --writev excludes --print, --printf and --print-n");
     }
-    /* check we got function names */
-    if (!_m_print) {
-        _m_print = "print";
+    if ((_opts.buffer || _opts.fastcgi) && (_opts.print || _opts.printf
+        || _opts.print_n || _opts.writev))
+    {
+        stop2("option --%s excludes --print, --printf, --print-n"
+                " and --writev", _opts.fastcgi ? "fastcgi" : "buffer");
     }
-    if (!_m_printf) {
-        _m_printf = "printf";
+    if (_opts.cxx && (_opts.print || _opts.printf || _opts.print_n
+        || _opts.writev || _opts.buffer || _opts.fastcgi))
+    {
+        stop("option --cxx excludes --print, --printf, --print-n, --writev,"
+                " --buffer and --fastcgi");
     }
-
-    /* start */
-
-    if (!_m_comment) {
-        /* print default comment */
-        char tmp[90];
-        time_t t = time(NULL);
-        strftime(tmp, 90, GENERATED_BY, localtime(&t));
-        if (fputs(tmp, stdout) == EOF) {
-            stop("lost stdout");
-        }
+    /* prepare translator */
+    if (!(_nb = nanabozo_new(&_opts))) {
+        stop("no memory");
     }
-    else if (*_m_comment) {
-        /* print user comment */
-        if (fprintf(stdout, "/*\n%s\n*/\n", _m_comment) < 0) {
-            stop("lost stdout");
-        }
+    nanabozo_set_output(_nb, &write_output, NULL);
+    if ((_scan_includes = _m_depfile || _watch)) {
+        nanabozo_set_includes(_nb, &record_include, NULL);
     }
-    if (!_print_given) {
-        /* define print(x) */
-        if (fputs(_M_PRINT_DEFINE, stdout) == EOF) {
-            stop("lost stdout");
-        }
+    nanabozo_set_partials(_nb, &load_partial, NULL);
+    if (_m_cache) {
+        /* may already exist */
+        mkdir(_m_cache, 0777);
     }
-    else if (!_printf_given) {
-        /* need stdio.h */
-        if (fputs(_M_PRINTF_DEFINE, stdout) == EOF) {
-            stop("lost stdout");
-        }
+    if (_m_output_pattern) {
+        check_outputs();
     }
-    if (_m_prefix && *_m_prefix) {
-        /* print prefix string */
-        if (fprintf(stdout, "%s\n", _m_prefix) < 0) {
-            stop("lost stdout");
-        }
+
+#ifdef __linux__
+    if (_watch) {
+        return watch();
     }
-    if (_do_mainfunc) {
-        if (fputs(MAINFUNC_START, stdout) == EOF) {
-            stop("lost stdout");
-        }
+#endif
+    if (_m_output_pattern) {
+        return batch();
     }
-    if (_do_send_headers) {
-        if (fprintf(stdout, "%s(\"%s\\n\\n\");\n",
-                    _m_print, CONTENTTYPE_HTML) < 0) {
-            stop("lost stdout");
+    /* open files */
+    if (_m_input_file) {
+        if (!freopen(_m_input_file, "r", stdin)) {
+            stop2("unable to open '%s' for reading", _m_input_file);
         }
     }
-#ifdef _MSC_VER
-    /* prepare buffer */
-    if (!(_buf = malloc(PAGESIZE))) {
-        stop("no memory");
+    _in_file = stdin;
+    if (_m_output_file) {
+        _out_file = open_output(_m_output_file);
     }
-    _bufsz = PAGESIZE;
-    _buf[0] = '\0';
-    _b = _buf;
-#endif
-    /* start scanning */
-    proceed();
-    /* send the last bits */
-    _reached_eof = 1;
-    bufout();
-    if (_do_mainfunc) {
-        if (fputs(MAINFUNC_STOP, stdout) == EOF) {
-            stop("lost stdout");
+    else {
+        /* we do our own buffering */
+        if (setvbuf(stdout, NULL, _IONBF, 0) != 0) {
+            stop("unable to reset buffering");
         }
+        _out_file = stdout;
     }
-    if (_m_suffix && *_m_suffix) {
-        /* print suffix string */
-        if (fprintf(stdout, "%s\n", _m_suffix)) {
-            stop("lost stdout");
-        }
+    translate();
+    if (_m_output_file && close_output(_m_output_file) != 0) {
+        stop2("unable to write '%s'", _m_output_file);
     }
+    if (_m_depfile && write_depfile(_m_depfile,
+                _m_dep_target ? _m_dep_target : _m_output_file) != 0)
+    {
+        stop2("unable to write '%s'", _m_depfile);
+    }
+    clear_includes();
+    clear_partials();
+    nanabozo_free(_nb);
     return EXIT_SUCCESS;
 }
-void proceed( void )
+void translate( void )
 {
-    struct match *mt = NULL;
+    double wall = 0;
+    clock_t cpu = 0;
 
-    while (read_input()) {
-        while ((mt = context_match())) {
-            if (mt->p > _q) {
-                /* eat preceding string */
-                (*_context_fallback)(mt->p);
-            }
-            assert(_q == mt->p);
-            (*mt->hook)(mt);
-            if (_q == _eol) {
-                break;
-            }
-        }
-        /* no more matches in current line */
-        if (_q != _eol) {
-            (*_context_fallback)(NULL);
+    if (_stats) {
+        wall = wall_clock();
+        cpu = clock();
+    }
+    load_input();
+    if (_stats) {
+        _read_wall = wall_clock() - wall;
+        _read_cpu = (double) (clock() - cpu) / CLOCKS_PER_SEC;
+    }
+    /* profiled regions are keyed by the script, stdin by the output */
+    nanabozo_set_name(_nb, _m_input_file);
+    if (_m_cache && cache_fetch()) {
+        /* already translated */
+        if (_stats) {
+            report_cached();
         }
+        unload_input();
+        return;
     }
+    if (nanabozo_translate(_nb, _src, _src_len) != NANABOZO_OK) {
+        _lineno = nanabozo_lineno(_nb);
+        stop(nanabozo_errmsg(_nb));
+    }
+    if (_stats) {
+        report_stats();
+    }
+    cache_store();
+    unload_input();
 }
-size_t read_input( void )
+void reset_state( void )
 {
-    assert(_q == _eol && _q_len == 0);
-    /* reset line */
-    memset(_input, 0, INPUTSIZE+1);
-    _q_len = 0;
-    _eol = _q = _input;
-    /* read line */
-    if (!fgets(_input, INPUTSIZE+1, stdin)) {
-        return 0;
+    unload_input();
+    _lineno = 0;
+    clear_includes();
+    clear_partials();
+}
+void add_input( char *fpath )
+{
+    if (!valid_filepath(fpath)) {
+        stop2("invalid argument '%s'", fpath);
+    }
+    if (_m_inputs_len == _m_inputs_sz) {
+        const size_t sz = _m_inputs_sz ? _m_inputs_sz * 2 : 64;
+        char **p = realloc(_m_inputs, sz * sizeof(char *));
+        if (!p) {
+            stop("no memory");
+        }
+        _m_inputs = p;
+        _m_inputs_sz = sz;
     }
-    _q_len = strlen(_input);
-    if (_q_len >= INPUTSIZE) {
-        stop2("reached maximum input size (%lu)", INPUTSIZE);
-    }
-    _eol += _q_len;
-    /* reset contexts */
-    reset_context(c_context);
-    reset_context(html_context);
-    reset_context(script_context);
-    reset_context(style_context);
-    reset_context(tag_context);
-    /* increment line count */
-    _lineno++;
-    return _q_len;
+    _m_inputs[_m_inputs_len++] = fpath;
 }
-struct match *context_match( void )
+void read_manifest( const char *fpath )
 {
-    struct match *next = NULL;
-    struct match *mt = _context;
-    char *p;
+    FILE *f = stdin;
+    size_t len = 0, sz = READSIZE, n;
+    char *p, *eol;
 
-    assert(_q != _eol);
-    for (; mt->str; mt++) {
-        if (!mt->p || mt->p < _q) {
-            /* mt was not searched in this context */
-            p = strstr(_q, mt->str);
-            mt->p = p ? p : _eol;
-        }
-        if (mt->p != _eol) {
-            /* something was found in this context */
-            if (!next || mt->p < next->p) {
-                /* mt is closer match */
-                next = mt;
+    if (strcmp(fpath, "-") && !(f = fopen(fpath, "r"))) {
+        stop2("unable to open '%s' for reading", fpath);
+    }
+    if (!(_manifest_buf = malloc(sz))) {
+        stop("no memory");
+    }
+    while ((n = fread(_manifest_buf + len, sizeof(char), sz - len - 1, f))) {
+        len += n;
+        if (len == sz - 1) {
+            sz *= 2;
+            if (!(p = realloc(_manifest_buf, sz))) {
+                stop("no memory");
             }
+            _manifest_buf = p;
         }
     }
-    return next;
-}
-void reset_context( struct match *mt )
-{
-    for (; mt->str; mt++) {
-        mt->p = NULL;
+    if (ferror(f)) {
+        stop2("unable to read '%s'", fpath);
     }
-}
-int valid_identifier( const char* id )
-{
-    if (!id || !*id || strlen(id) >= 256
-        || !strchr(NONDIGIT CPPSPECIAL, *id++))
-    {
-        return 0;
+    if (f != stdin) {
+        fclose(f);
     }
-    for (; *id; id++) {
-        if (!strchr(NONDIGIT DIGIT CPPSPECIAL, *id)) {
-            return 0;
+    _manifest_buf[len] = '\0';
+    /* one file per line, skip blank lines and comments */
+    for (p = _manifest_buf; *p; p = eol) {
+        if ((eol = strchr(p, '\n'))) {
+            *eol++ = '\0';
+        }
+        else {
+            eol = p + strlen(p);
+        }
+        if (*p && p[strlen(p)-1] == '\r') {
+            p[strlen(p)-1] = '\0';
+        }
+        if (*p && *p != '#') {
+            add_input(p);
         }
     }
-    return 1;
 }
-int valid_filepath( const char* fpath )
+int output_path( char *dst, const size_t sz, const char *pattern,
+        const char *input, const char *ext )
 {
-    if (!fpath || !*fpath || *fpath == '-' || strlen(fpath) >= 4096) {
-        return 0;
-    }
-    for (; *fpath; fpath++) {
-        if (!strchr(NONDIGIT DIGIT SPECIALCHAR, *fpath)) {
-            return 0;
+    const char *base = input, *dot, *p;
+    int n;
+
+    /* input base name, without extension */
+    for (p = input; *p; p++) {
+        if (*p == '/' || *p == '\\') {
+            base = p + 1;
         }
     }
-    return 1;
+    if (!(dot = strrchr(base, '.')) || dot == base) {
+        dot = base + strlen(base);
+    }
+    if ((p = strstr(pattern, "%s"))) {
+        n = snprintf(dst, sz, "%.*s%.*s%s", (int) (p - pattern),
+                pattern, (int) (dot - base), base, p + 2);
+    }
+    else {
+        n = snprintf(dst, sz, "%s/%.*s%s", pattern,
+                (int) (dot - base), base, ext);
+    }
+    return (n < 0 || (size_t) n >= sz || !valid_filepath(dst)) ? -1 : 0;
 }
-#ifndef _MSC_VER
-void bufwrite( const char *s, const size_t len )
+struct batch_output
 {
-    if ((!_f && !(_f = open_memstream(&_buf, &_bufsz)))
-        || fwrite(s, sizeof(char), len, _f) != len)
-    {
+    char *path;
+    size_t i;       /* input */
+};
+void check_outputs( void )
+{
+    struct batch_output *outs;
+    size_t i, n = 0;
+
+    /* inputs of the same base name would overwrite each other */
+    if (!(outs = malloc((_m_inputs_len + 1) * sizeof(*outs)))) {
         stop("no memory");
     }
-}
-#else
-void bufwrite( const char *s, const size_t len )
-{
-    if (_b_len + len >= _bufsz) {
-        const size_t sz = (((_bufsz + len) / PAGESIZE) + 1) * PAGESIZE;
-        if (!(_buf = realloc(_buf, sz))) {
-            stop("no memory");
+    for (i = 0; i < _m_inputs_len; i++) {
+        /* bad names are reported with their file */
+        if (output_path(_batch_output, sizeof(_batch_output),
+                    _m_output_pattern, _m_inputs[i], ".c") == 0)
+        {
+            if (!(outs[n].path = strdup(_batch_output))) {
+                stop("no memory");
+            }
+            outs[n++].i = i;
+        }
+    }
+    qsort(outs, n, sizeof(*outs), &cmp_outputs);
+    for (i = 1; i < n; i++) {
+        if (!strcmp(outs[i-1].path, outs[i].path)) {
+            stop2("'%s' and '%s' are both translated to '%s'",
+                    _m_inputs[outs[i-1].i], _m_inputs[outs[i].i],
+                    outs[i].path);
         }
-        _bufsz = sz;
-        _b = _buf + _b_len;
     }
-    _b_len += len;
-    strncat(_b, s, len);
-    _b += len;
+    for (i = 0; i < n; i++) {
+        free(outs[i].path);
+    }
+    free(outs);
 }
-#endif
-void bufout( void )
+int cmp_outputs( const void *a, const void *b )
+{
+    const struct batch_output *const x = a, *const y = b;
+    const int c = strcmp(x->path, y->path);
+
+    /* same path, inputs in the order given */
+    return c ? c : (x->i > y->i) - (x->i < y->i);
+}
+int batch( void )
 {
+    size_t jobs = (size_t) _jobs;
 #ifndef _MSC_VER
-    if (!_f) {
-        return;
+    size_t k;
+    int status, failed = 0;
+    pid_t pid;
+
+    if (!jobs) {
+        const long n = sysconf(_SC_NPROCESSORS_ONLN);
+        jobs = n > 0 ? (size_t) n : 1;
     }
-    fclose(_f);
-    _f = NULL;
-    if (_bufsz) {
-#else
-    if (_b_len) {
-#endif
-        char *p = _buf;
-        /* dont send trailing spaces */
-        if (_reached_eof) {
-            while (*p && isspace(*p)) {
-                ++p;
+    if (jobs > _m_inputs_len) {
+        jobs = _m_inputs_len;
+    }
+    if (jobs > 1) {
+        /* worker processes, each one takes every jobs-th file: the library
+           is reentrant, but this front end keeps the file being translated,
+           its mapping, output, dependencies and partials in globals, and
+           stop() longjmps per process */
+        fflush(NULL);
+        for (k = 0; k < jobs; k++) {
+            if ((pid = fork()) < 0) {
+                stop("unable to fork");
             }
-            if (!*p) {
-                goto bufout_done;
-            }
-            else {
-                p = _buf;
+            if (!pid) {
+                exit(batch_worker(k, jobs) ? EXIT_FAILURE : EXIT_SUCCESS);
             }
         }
-        /* transfer buffer to stdout */
-        if (fprintf(stdout, "\n%s(\"", _m_print) < 0) {
-            stop("lost stdout");
-        }
-        for (; *p; p++) {
-            switch (*p) {
-            case '\\':
-                write("\\\\", 2);
-                break;
-            case '"':
-                write("\\\"", 2);
-                break;
-            case '\n':
-                if (*(p+1)) {
-                    write("\\n\"\n\"", 5);
-                }
-                else {
-                    write("\\n\"", 3);
-                }
-                break;
-            case '\r':
-                write("\\r", 2);
-                break;
-            case '\t':
-                write("\\t", 2);
-                break;
-            case '\a':
-            case '\b':
-            case '\f':
-            case '\v':
-                break;
-            default:
-                put(*p);
+        while (wait(&status) > 0) {
+            if (!WIFEXITED(status) || WEXITSTATUS(status) != EXIT_SUCCESS) {
+                failed = 1;
             }
         }
-        if (*(p-1) != '\n') {
-            write("\");\n", 4);
-        }
-        else {
-            write(");\n", 3);
-        }
-    bufout_done:
-#ifndef _MSC_VER
-        _bufsz = 0;
-#else
-        /* reset buffer */
-        free(_buf);
-        _buf = NULL;
-        if (!(_buf = malloc(PAGESIZE))) {
-            stop("no memory");
-        }
-        _bufsz = PAGESIZE;
-        _buf[0] = '\0';
-        _b_len = 0;
-        _b = _buf;
-#endif
-    }
-#ifndef _MSC_VER
-    /* reset buffer */
-    if (_buf) {
-        free(_buf);
-        _buf = NULL;
+        nanabozo_free(_nb);
+        return failed ? EXIT_FAILURE : EXIT_SUCCESS;
     }
+#else
+    (void) jobs;
 #endif
+    return batch_worker(0, 1) ? EXIT_FAILURE : EXIT_SUCCESS;
 }
-#ifndef _MSC_VER
-void bufput( const int c )
+int batch_worker( const size_t first, const size_t step )
 {
-    if ((!_f && !(_f = open_memstream(&_buf, &_bufsz)))
-        || fputc(c, _f) != c)
-    {
-        stop("no memory");
+    size_t i;
+    int failed = 0;
+
+    for (i = first; i < _m_inputs_len; i += step) {
+        if (batch_file(i) != 0) {
+            failed++;
+        }
     }
+    nanabozo_free(_nb);
+    return failed;
 }
-#else
-void bufput( const int c )
+int batch_file( const size_t i )
 {
-    char tmp[2] = {'\0', '\0'};
-    if (_b_len + 1 >= _bufsz) {
-        const size_t sz = (((_bufsz + 1) / PAGESIZE) + 1) * PAGESIZE;
-        if (!(_buf = realloc(_buf, sz))) {
-            stop("no memory");
+    _m_input_file = _m_inputs[i];
+    _m_output_file = _batch_output;
+    _in_file = _out_file = NULL;
+    reset_state();
+    if (setjmp(_batch_env)) {
+        /* translation stopped, error already reported */
+        _batch_file = 0;
+        if (_in_file) {
+            fclose(_in_file);
         }
-        _bufsz = sz;
-        _b = _buf + _b_len;
+        reset_state();
+        return -1;
     }
-    _b_len++;
-    tmp[0] = c;
-    strcat(_b, tmp);
-    _b++;
-}
-#endif
-void write( const char *s, const size_t len )
-{
-    if (fwrite(s, sizeof(char), len, stdout) != len) {
-        stop("lost stdout");
+    _batch_file = 1;
+    if (output_path(_batch_output, sizeof(_batch_output),
+                _m_output_pattern, _m_input_file, ".c"))
+    {
+        _m_output_file = NULL;
+        stop("invalid output file name");
     }
-}
-void put( const int c )
-{
-    if (fputc(c, stdout) != c) {
-        stop("lost stdout");
+    if (!(_in_file = fopen(_m_input_file, "r"))) {
+        stop2("unable to open '%s' for reading", _m_input_file);
     }
+    _out_file = open_output(_batch_output);
+    translate();
+    fclose(_in_file);
+    _in_file = NULL;
+    if (close_output(_batch_output) != 0) {
+        stop2("unable to write '%s'", _batch_output);
+    }
+    if (_m_depfile) {
+        char depfile[sizeof(_batch_output)], target[sizeof(_batch_output)];
+        if (output_path(depfile, sizeof(depfile), _m_depfile,
+                    _m_input_file, ".d")
+            || (_m_dep_target && output_path(target, sizeof(target),
+                    _m_dep_target, _m_input_file, "")))
+        {
+            stop("invalid dependencies file name");
+        }
+        if (write_depfile(depfile,
+                    _m_dep_target ? target : _batch_output) != 0)
+        {
+            stop2("unable to write '%s'", depfile);
+        }
+    }
+    _batch_file = 0;
+    return 0;
 }
-int cursor( void )
-{
-  if (_q != _eol || read_input()) {
-      _q_len--;
-      return *_q++;
-  }
-  return EOF;
-}
-void c_fallback( const char *eol )
-{
-    const size_t sz = eol ? (size_t) (eol - _q) : _q_len;
-    assert(*_q && sz);
-    write(_q, sz);
-    _q += sz;
-    _q_len -= sz;
-}
-void html_fallback( const char *eol )
-{
-    const size_t sz = eol ? (size_t) (eol - _q) : _q_len;
-    assert(*_q && sz);
-    bufwrite(_q, sz);
-    _q += sz;
-    _q_len -= sz;
-}
-void bad_tag_end( struct match *mt )
-{
-    (void) mt;
-    stop("special char '>' => '&gt;' ?");
-}
-void bad_tag_start( struct match *mt )
-{
-    (void) mt;
-    stop("special char '<' => '&lt;' ?");
-}
-void c_dquote_start( struct match *mt )
-{
-    write(_q, mt->len);
-    _q += mt->len;
-    _q_len -= mt->len;
-    eat_c_dquote();
-}
-void c_end( struct match *mt )
+FILE *open_output( const char *fpath )
 {
-    if (!_no_comments
-        && fprintf(stdout, "/* END C (line %lu) */", _lineno) < 0)
+    FILE *f;
+
+    if ((size_t) snprintf(_out_tmp, sizeof(_out_tmp), "%s.tmp%ld",
+                fpath, (long) getpid()) >= sizeof(_out_tmp)
+        || !(f = fopen(_out_tmp, "w")))
     {
-        stop("lost stdout");
+        _out_tmp[0] = '\0';
+        stop2("unable to open '%s' for writing", fpath);
     }
-    _q += mt->len;
-    _q_len -= mt->len;
-    _context = html_context;
-    _context_fallback = &html_fallback;
-}
-void c_macro_start( struct match *mt )
-{
-    write(_q, mt->len);
-    _q += mt->len;
-    _q_len -= mt->len;
-    eat_c_macro();
+    /* we do our own buffering */
+    if (setvbuf(f, NULL, _IONBF, 0) != 0) {
+        fclose(f);
+        remove(_out_tmp);
+        _out_tmp[0] = '\0';
+        stop("unable to reset buffering");
+    }
+    return f;
 }
-void c_ml_comment_start( struct match *mt )
+int close_output( const char *fpath )
 {
-    write(_q, mt->len);
-    _q += mt->len;
-    _q_len -= mt->len;
-    eat_c_ml_comment();
+    int err = fclose(_out_file) != 0;
+
+    _out_file = NULL;
+    if (!err && same_content(_out_tmp, fpath)) {
+        /* unchanged, keep old file and its time stamp */
+        remove(_out_tmp);
+    }
+    else if (!err) {
+#ifdef _MSC_VER
+        remove(fpath);
+#endif
+        err = rename(_out_tmp, fpath) != 0;
+    }
+    if (err) {
+        remove(_out_tmp);
+    }
+    _out_tmp[0] = '\0';
+    return err ? -1 : 0;
 }
-void c_sl_comment_start( struct match *mt )
+void discard_output( void )
 {
-    write(_q, mt->len);
-    _q += mt->len;
-    _q_len -= mt->len;
-    eat_c_sl_comment();
+    if (!_out_tmp[0]) {
+        return;
+    }
+    if (_out_file) {
+        fclose(_out_file);
+        _out_file = NULL;
+    }
+    remove(_out_tmp);
+    _out_tmp[0] = '\0';
 }
-void c_squote_start( struct match *mt )
+int same_content( const char *fpath1, const char *fpath2 )
 {
-    write(_q, mt->len);
-    _q += mt->len;
-    _q_len -= mt->len;
-    eat_c_squote();
+    char a[8192], b[8192];
+    FILE *f1, *f2;
+    size_t n1, n2;
+    int same = 0;
+
+    if (!(f1 = fopen(fpath1, "rb"))) {
+        return 0;
+    }
+    if (!(f2 = fopen(fpath2, "rb"))) {
+        fclose(f1);
+        return 0;
+    }
+    for (;;) {
+        n1 = fread(a, sizeof(char), sizeof(a), f1);
+        n2 = fread(b, sizeof(char), sizeof(b), f2);
+        if (n1 != n2 || memcmp(a, b, n1)) {
+            break;
+        }
+        if (!n1) {
+            same = !ferror(f1) && !ferror(f2);
+            break;
+        }
+    }
+    fclose(f1);
+    fclose(f2);
+    return same;
 }
-void c_start( struct match *mt )
+int write_output( void *arg, const char *s, size_t len )
 {
-    bufout();
-    if (!_no_comments
-        && fprintf(stdout, "/* BEGIN C (line %lu) */\n", _lineno) < 0)
-    {
-        stop("lost stdout");
+    (void) arg;
+    if (_cache_file && fwrite(s, sizeof(char), len, _cache_file) != len) {
+        cache_discard();
     }
-    _q += mt->len;
-    _q_len -= mt->len;
-    _context = c_context;
-    _context_fallback = &c_fallback;
+    return fwrite(s, sizeof(char), len, _out_file) != len ? -1 : 0;
 }
-void c_print_format_start( struct match *mt )
+int cache_fetch( void )
 {
-    bufout();
-    if (!_no_comments
-        && fprintf(stdout, "/* BEGIN C%% (line %lu) */\n", _lineno) < 0)
+    const int flags[] = { _opts.mainfunc, _opts.send_headers,
+        _opts.no_comments, _opts.deterministic, _opts.sized,
+        _opts.writev, _opts.buffer, _opts.fastcgi, _opts.minify,
+        _opts.compile_formats, _opts.profile_regions };
+    uint64_t h = HASH_INIT;
+    char tmp[8192];
+    size_t n;
+    FILE *f;
+
+    /* all that makes the output */
+    h = hash_str(h, VERSION_STR);
+    h = hash_bytes(h, flags, sizeof(flags));
+    h = hash_str(h, _opts.comment);
+    h = hash_str(h, _opts.prefix);
+    h = hash_str(h, _opts.suffix);
+    h = hash_str(h, _opts.print);
+    h = hash_str(h, _opts.printf);
+    h = hash_str(h, _opts.print_n);
+    h = hash_str(h, _opts.cxx);
+    h = hash_str(h, _opts.profile_regions ? _m_input_file : NULL);
+    h = hash_bytes(h, _src, _src_len);
+    if ((size_t) snprintf(_cache_path, sizeof(_cache_path), "%s/%016llx.c",
+                _m_cache, (unsigned long long) h) >= sizeof(_cache_path))
     {
-        stop("lost stdout");
+        stop("cache path too long");
     }
-    _q += mt->len;
-    _q_len -= mt->len;
-    eat_c_print_format();
-    if (!_no_comments
-        && fprintf(stdout, "\n/* END C%% (line %lu) */", _lineno) < 0)
-    {
-        stop("lost stdout");
+    if (!cache_partials()) {
+        /* a partial changed, translate again */
+        f = NULL;
     }
-}
-void c_print_start( struct match *mt )
-{
-    bufout();
-    if (!_no_comments
-        && fprintf(stdout, "/* BEGIN C= (line %lu) */\n", _lineno) < 0)
-    {
-        stop("lost stdout");
+    else if (_scan_includes) {
+        /* includes of the entry, one per line */
+        snprintf(tmp, sizeof(tmp), "%s.d", _cache_path);
+        if ((f = fopen(tmp, "r"))) {
+            while (fgets(tmp, sizeof(tmp), f)) {
+                if ((n = strcspn(tmp, "\r\n"))
+                    && record_include(NULL, tmp, n) != 0)
+                {
+                    fclose(f);
+                    stop("no memory");
+                }
+            }
+            fclose(f);
+            f = fopen(_cache_path, "rb");
+        }
+        if (!f) {
+            /* translate again, includes are needed */
+            clear_includes();
+        }
+    }
+    else {
+        f = fopen(_cache_path, "rb");
+    }
+    if (f) {
+        /* hit, send it as is */
+        while ((n = fread(tmp, sizeof(char), sizeof(tmp), f))) {
+            if (write_output(NULL, tmp, n) != 0) {
+                fclose(f);
+                stop("lost stdout");
+            }
+        }
+        if (ferror(f)) {
+            fclose(f);
+            stop2("unable to read '%s'", _cache_path);
+        }
+        fclose(f);
+        return 1;
     }
-    _q += mt->len;
-    _q_len -= mt->len;
-    eat_c_print_string();
-    if (!_no_comments
-        && fprintf(stdout, "\n/* END C= (line %lu) */", _lineno) < 0)
+    /* miss, keep a copy of the output (best effort) */
+    if ((size_t) snprintf(_cache_tmp, sizeof(_cache_tmp), "%s.tmp%ld",
+                _cache_path, (long) getpid()) < sizeof(_cache_tmp))
     {
-        stop("lost stdout");
+        _cache_file = fopen(_cache_tmp, "wb");
     }
+    return 0;
 }
-void html_comment_start( struct match *mt )
+void cache_store( void )
 {
-    bufwrite(_q, mt->len);
-    _q += mt->len;
-    _q_len -= mt->len;
-    eat_html_comment();
-}
-void script_dquote_start( struct match* mt )
-{
-    bufwrite(_q, mt->len);
-    _q += mt->len;
-    _q_len -= mt->len;
-    eat_script_dquote();
+    char fpath[sizeof(_cache_tmp)+2], dpath[sizeof(_cache_path)+2];
+    size_t i;
+    FILE *f;
+    int err;
+
+    if (!_cache_file) {
+        return;
+    }
+    err = fclose(_cache_file) != 0;
+    _cache_file = NULL;
+    if (!err && _partials_len) {
+        /* partials of the entry, to tell when they change */
+        snprintf(fpath, sizeof(fpath), "%s.p", _cache_tmp);
+        snprintf(dpath, sizeof(dpath), "%s.p", _cache_path);
+        if (!(f = fopen(fpath, "w"))) {
+            err = 1;
+        }
+        else {
+            for (i = 0; i < _partials_len; i++) {
+                fprintf(f, "%016llx %s\n", (unsigned long long) hash_bytes(
+                            HASH_INIT, _partials[i].src,
+                            _partials[i].len), _partials[i].name);
+            }
+            if (fclose(f) != 0 || rename(fpath, dpath) != 0) {
+                remove(fpath);
+                err = 1;
+            }
+        }
+    }
+    if (!err && _scan_includes) {
+        /* includes go aside, before the entry is made visible */
+        snprintf(fpath, sizeof(fpath), "%s.d", _cache_tmp);
+        snprintf(dpath, sizeof(dpath), "%s.d", _cache_path);
+        if (!(f = fopen(fpath, "w"))) {
+            err = 1;
+        }
+        else {
+            for (i = 0; i < _includes_len; i++) {
+                fprintf(f, "%s\n", _includes[i]);
+            }
+            if (fclose(f) != 0 || rename(fpath, dpath) != 0) {
+                remove(fpath);
+                err = 1;
+            }
+        }
+    }
+    if (err || rename(_cache_tmp, _cache_path) != 0) {
+        remove(_cache_tmp);
+    }
 }
-void script_ml_comment_start( struct match* mt )
+void cache_discard( void )
 {
-    bufwrite(_q, mt->len);
-    _q += mt->len;
-    _q_len -= mt->len;
-    eat_script_ml_comment();
+    if (!_cache_file) {
+        return;
+    }
+    fclose(_cache_file);
+    remove(_cache_tmp);
+    _cache_file = NULL;
 }
-void script_sl_comment_start( struct match* mt )
+int cache_partials( void )
 {
-    bufwrite(_q, mt->len);
-    _q += mt->len;
-    _q_len -= mt->len;
-    eat_script_sl_comment();
+    char tmp[8192], *name;
+    unsigned long long h;
+    const char *src;
+    size_t len;
+    int fresh = 1;
+    FILE *f;
+
+    /* none if no list */
+    snprintf(tmp, sizeof(tmp), "%s.p", _cache_path);
+    if (!(f = fopen(tmp, "r"))) {
+        return 1;
+    }
+    while (fresh && fgets(tmp, sizeof(tmp), f)) {
+        tmp[strcspn(tmp, "\r\n")] = '\0';
+        h = strtoull(tmp, &name, 16);
+        fresh = *name++ == ' '
+            && load_partial(NULL, name, strlen(name), &src, &len) == 0
+            && hash_bytes(HASH_INIT, src, len) == h;
+    }
+    fclose(f);
+    return fresh;
 }
-void script_squote_start( struct match* mt )
+uint64_t hash_bytes( uint64_t h, const void *p, const size_t len )
 {
-    bufwrite(_q, mt->len);
-    _q += mt->len;
-    _q_len -= mt->len;
-    eat_script_squote();
+    const unsigned char *c = p;
+    const unsigned char *const end = c + len;
+
+    for (; c != end; c++) {
+        h ^= *c;
+        h *= 1099511628211ULL;
+    }
+    return h;
 }
-void script_end( struct match *mt )
+uint64_t hash_str( uint64_t h, const char *s )
 {
-    bufwrite(_q, mt->len);
-    _q += mt->len;
-    _q_len -= mt->len;
-    _context = html_context;
-    _context_fallback = &html_fallback;
+    /* tell null from empty */
+    if (!s) {
+        return hash_bytes(h, "", 1);
+    }
+    h = hash_bytes(h, "\1", 1);
+    return hash_bytes(h, s, strlen(s) + 1);
 }
-void script_start( struct match *mt )
+void add_include_dir( char *dir )
 {
-    bufwrite(_q, mt->len);
-    _q += mt->len;
-    _q_len -= mt->len;
-    _context = script_context;
-    _context_fallback = &html_fallback;
+    char **p;
+
+    if (!valid_filepath(dir)) {
+        stop2("invalid argument '%s'", dir);
+    }
+    if (!(p = realloc(_m_include_dirs,
+                    (_m_include_dirs_len + 1) * sizeof(char *))))
+    {
+        stop("no memory");
+    }
+    _m_include_dirs = p;
+    _m_include_dirs[_m_include_dirs_len++] = dir;
 }
-void style_end( struct match *mt )
+int record_include( void *arg, const char *name, size_t len )
 {
-    bufwrite(_q, mt->len);
-    _q += mt->len;
-    _q_len -= mt->len;
-    _context = html_context;
-    _context_fallback = &html_fallback;
+    size_t i;
+    char *s;
+
+    (void) arg;
+    for (i = 0; i < _includes_len; i++) {
+        if (!strncmp(_includes[i], name, len) && !_includes[i][len]) {
+            return 0;
+        }
+    }
+    if (_includes_len == _includes_sz) {
+        const size_t sz = _includes_sz ? _includes_sz * 2 : 16;
+        char **p = realloc(_includes, sz * sizeof(char *));
+        if (!p) {
+            return -1;
+        }
+        _includes = p;
+        _includes_sz = sz;
+    }
+    if (!(s = malloc(len + 1))) {
+        return -1;
+    }
+    memcpy(s, name, len);
+    s[len] = '\0';
+    _includes[_includes_len++] = s;
+    return 0;
 }
-void style_ml_comment_start( struct match* mt )
+void clear_includes( void )
 {
-    bufwrite(_q, mt->len);
-    _q += mt->len;
-    _q_len -= mt->len;
-    eat_script_ml_comment();
+    while (_includes_len) {
+        free(_includes[--_includes_len]);
+    }
 }
-void style_start( struct match *mt )
+int resolve_include( char *dst, const size_t sz, const char *name )
 {
-    bufwrite(_q, mt->len);
-    _q += mt->len;
-    _q_len -= mt->len;
-    _context = style_context;
-    _context_fallback = &html_fallback;
+    const char *p;
+    size_t i, dirlen = 0;
+    FILE *f;
+    int n;
+
+    /* relative to the script first */
+    if (_m_input_file && *name != '/') {
+        for (p = _m_input_file; *p; p++) {
+            if (*p == '/' || *p == '\\') {
+                dirlen = (size_t) (p - _m_input_file) + 1;
+            }
+        }
+    }
+    n = snprintf(dst, sz, "%.*s%s", (int) dirlen,
+            _m_input_file ? _m_input_file : "", name);
+    for (i = 0; ; i++) {
+        if (n >= 0 && (size_t) n < sz && (f = fopen(dst, "r"))) {
+            fclose(f);
+            return 0;
+        }
+        /* then in include dirs */
+        if (*name == '/' || i == _m_include_dirs_len) {
+            return -1;
+        }
+        n = snprintf(dst, sz, "%s/%s", _m_include_dirs[i], name);
+    }
 }
-void tag_dquote_start( struct match *mt )
+int load_partial( void *arg, const char *name, size_t len,
+        const char **src, size_t *srclen )
 {
-    bufwrite(_q, mt->len);
-    _q += mt->len;
-    _q_len -= mt->len;
-    eat_script_dquote();
+    char fpath[4096];
+    struct partial *pt;
+    size_t i, sz, n;
+    int err = 0;
+    FILE *f;
+
+    (void) arg;
+    for (i = 0; i < _partials_len; i++) {
+        if (!strncmp(_partials[i].name, name, len)
+            && !_partials[i].name[len])
+        {
+            /* loaded already, for this script */
+            *src = _partials[i].src;
+            *srclen = _partials[i].len;
+            return 0;
+        }
+    }
+    if (_partials_len == _partials_sz) {
+        sz = _partials_sz ? _partials_sz * 2 : 16;
+        if (!(pt = realloc(_partials, sz * sizeof(struct partial)))) {
+            return -1;
+        }
+        _partials = pt;
+        _partials_sz = sz;
+    }
+    pt = &_partials[_partials_len];
+    if (!(pt->name = malloc(len + 1))) {
+        return -1;
+    }
+    memcpy(pt->name, name, len);
+    pt->name[len] = '\0';
+    /* found like quoted includes, and a dependency as well */
+    if (resolve_include(fpath, sizeof(fpath), pt->name)
+        || !(f = fopen(fpath, "rb")))
+    {
+        free(pt->name);
+        return -1;
+    }
+    pt->src = NULL;
+    pt->len = 0;
+    for (sz = READSIZE; ; sz *= 2) {
+        char *p = realloc(pt->src, sz);
+        if (!p) {
+            err = 1;
+            break;
+        }
+        pt->src = p;
+        pt->len += (n = fread(p + pt->len, sizeof(char), sz - pt->len, f));
+        if (pt->len < sz) {
+            break;
+        }
+    }
+    err |= ferror(f);
+    err |= fclose(f) != 0;
+    if (err || (_scan_includes && record_include(NULL, name, len) != 0)) {
+        free(pt->src);
+        free(pt->name);
+        return -1;
+    }
+    _partials_len++;
+    *src = pt->src;
+    *srclen = pt->len;
+    return 0;
 }
-void tag_end( struct match *mt )
+void clear_partials( void )
 {
-    bufwrite(_q, mt->len);
-    _q += mt->len;
-    _q_len -= mt->len;
-    _context = html_context;
-    _context_fallback = &html_fallback;
+    while (_partials_len) {
+        _partials_len--;
+        free(_partials[_partials_len].name);
+        free(_partials[_partials_len].src);
+    }
 }
-void tag_squote_start( struct match *mt )
+int write_depfile( const char *depfile, const char *target )
 {
-    bufwrite(_q, mt->len);
-    _q += mt->len;
-    _q_len -= mt->len;
-    eat_script_squote();
+    char fpath[4096], tmp[4096+32];
+    size_t i;
+    FILE *f;
+    int err;
+
+    /* written aside, like output files */
+    if ((size_t) snprintf(tmp, sizeof(tmp), "%s.tmp%ld",
+                depfile, (long) getpid()) >= sizeof(tmp)
+        || !(f = fopen(tmp, "w")))
+    {
+        return -1;
+    }
+    dep_escape(f, target);
+    fputc(':', f);
+    if (_m_input_file) {
+        fputc(' ', f);
+        dep_escape(f, _m_input_file);
+    }
+    for (i = 0; i < _includes_len; i++) {
+        if (!resolve_include(fpath, sizeof(fpath), _includes[i])) {
+            fputs(" \\\n ", f);
+            dep_escape(f, fpath);
+        }
+    }
+    fputc('\n', f);
+    /* like -MP, so that make does not choke on removed files */
+    for (i = 0; i < _includes_len; i++) {
+        if (!resolve_include(fpath, sizeof(fpath), _includes[i])) {
+            fputc('\n', f);
+            dep_escape(f, fpath);
+            fputs(":\n", f);
+        }
+    }
+    if ((err = fclose(f) != 0) == 0 && same_content(tmp, depfile)) {
+        remove(tmp);
+        return 0;
+    }
+#ifdef _MSC_VER
+    if (!err) {
+        remove(depfile);
+    }
+#endif
+    if (err || rename(tmp, depfile) != 0) {
+        remove(tmp);
+        return -1;
+    }
+    return 0;
 }
-void tag_start( struct match *mt )
+void dep_escape( FILE *f, const char *s )
 {
-    bufwrite(_q, mt->len);
-    _q += mt->len;
-    _q_len -= mt->len;
-    _context = tag_context;
-    _context_fallback = &html_fallback;
+    for (; *s; s++) {
+        switch (*s) {
+        case ' ':
+        case '#':
+            fputc('\\', f);
+            break;
+        case '$':
+            fputc('$', f);
+            break;
+        }
+        fputc(*s, f);
+    }
 }
-void eat_c_dquote( void )
+#ifdef __linux__
+int watch( void )
 {
-    int i, prev = -1;
-    while ((i = cursor()) != EOF) {
-        if (i == '\n') {
-            stop("unexpected newline in C double-quoted string");
+    char ev[64 * (sizeof(struct inotify_event) + 256)]
+        __attribute__((aligned(__alignof__(struct inotify_event))));
+    const struct inotify_event *e;
+    unsigned char *dirty;
+    size_t i, k;
+    ssize_t n;
+    char *p;
+    int fd;
+
+    if ((fd = inotify_init1(IN_CLOEXEC)) < 0) {
+        stop("unable to watch files");
+    }
+    if (!(dirty = calloc(_m_inputs_len, sizeof(unsigned char)))) {
+        stop("no memory");
+    }
+    /* first pass, in process to learn includes */
+    for (i = 0; i < _m_inputs_len; i++) {
+        watch_input(fd, i);
+    }
+    for (;;) {
+        if ((n = read(fd, ev, sizeof(ev))) < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            stop("unable to watch files");
         }
-        put(i);
-        if (i == '"' && prev != '\\') {
-            return;
+        /* files are saved in place, or renamed over */
+        for (p = ev; p < ev + n; p += sizeof(struct inotify_event) + e->len) {
+            e = (const struct inotify_event *) p;
+            if (!e->len) {
+                continue;
+            }
+            for (k = 0; k < _watched_len; k++) {
+                if (_watched[k].wd == e->wd
+                    && !strcmp(_watched[k].base, e->name))
+                {
+                    dirty[_watched[k].input] = 1;
+                }
+            }
+        }
+        for (i = 0; i < _m_inputs_len; i++) {
+            if (dirty[i]) {
+                dirty[i] = 0;
+                watch_input(fd, i);
+            }
         }
-        prev = i;
     }
-    stop("eof while scanning C double-quoted string");
 }
-void eat_c_macro( void )
+void watch_input( const int fd, const size_t i )
 {
-    int i, j = 0, prev = -1;
-    while (j || (i = cursor()) != EOF) {
-        if (j) {
-            i = j;
-            j = 0;
+    char fpath[4096];
+    size_t k;
+
+    if (batch_file(i) != 0) {
+        /* keep what we had, or at least the script */
+        for (k = 0; k < _watched_len && _watched[k].input != i; k++) {
+            ;
         }
-        switch (i) {
-        case '"':
-            /* dquote string begins */
-            put(i);
-            eat_c_dquote();
-            prev = -1;
-            continue;
-        case '\'':
-            /* squote char begins */
-            put(i);
-            eat_c_squote();
-            prev = -1;
-            continue;
-        case '/':
-            switch ((j = cursor())) {
-            case EOF:
-                stop("eof while scanning C macro");
-                return;
-            case '*':
-                /* ml comment begins */
-                write("/*", 2);
-                eat_c_ml_comment();
-                return;
-            case '/':
-                /* sl comment begins */
-                write("//", 2);
-                eat_c_sl_comment();
-                return;
-            }
+        if (k == _watched_len) {
+            watch_file(fd, _m_inputs[i], i);
         }
-        put(i);
-        if (i == '\n' && prev != '\\') {
-            /* end of macro */
-            return;
+        return;
+    }
+    unwatch_input(i);
+    watch_file(fd, _m_inputs[i], i);
+    for (k = 0; k < _includes_len; k++) {
+        if (!resolve_include(fpath, sizeof(fpath), _includes[k])) {
+            watch_file(fd, fpath, i);
         }
-        prev = i;
     }
-    stop("eof while scanning C macro");
 }
-void eat_c_print_format( void )
+void watch_file( const int fd, const char *fpath, const size_t i )
 {
-    int i, j = 0;
-    if (fprintf(stdout, "%s(", _m_printf) < 0) {
-        stop("lost stdout");
-    }
-    while (j || (i = cursor()) != EOF) {
-        if (j) {
-            i = j;
-            j = 0;
+    struct watched *w;
+    const char *base = fpath, *p;
+
+    if (_watched_len == _watched_sz) {
+        const size_t sz = _watched_sz ? _watched_sz * 2 : 64;
+        if (!(w = realloc(_watched, sz * sizeof(struct watched)))) {
+            stop("no memory");
         }
-        switch (i)
-        {
-        case '"':
-            /* dquote string begins */
-            put(i);
-            eat_c_dquote();
-            continue;
-        case '\'':
-            /* squote char begins */
-            put(i);
-            eat_c_squote();
-            continue;
-        case '?':
-            switch ((j = cursor())) {
-            case EOF:
-                stop("eof while scanning C print-formatted arguments");
-                return;
-            case '>':
-                /* end tag */
-                write(");", 2);
-                return;
-            default:
-                put('?');
-                continue;
-            }
+        _watched = w;
+        _watched_sz = sz;
+    }
+    w = &_watched[_watched_len];
+    for (p = fpath; *p; p++) {
+        if (*p == '/') {
+            base = p + 1;
         }
-        put(i);
     }
-    stop("eof while scanning C print-formatted arguments");
+    /* the directory is watched, editors often replace files */
+    if (!(w->dir = malloc(strlen(fpath) + 3))) {
+        stop("no memory");
+    }
+    if (base == fpath) {
+        strcpy(w->dir, ".");
+    }
+    else {
+        sprintf(w->dir, "%.*s", (int) (base - fpath), fpath);
+    }
+    w->base = w->dir + strlen(w->dir) + 1;
+    strcpy(w->base, base);
+    w->input = i;
+    if ((w->wd = inotify_add_watch(fd, w->dir,
+                    IN_CLOSE_WRITE | IN_MOVED_TO)) < 0)
+    {
+        free(w->dir);
+        fprintf(stderr, "\nnanabozo warning: unable to watch '%s'\n", fpath);
+        return;
+    }
+    _watched_len++;
 }
-void eat_c_print_string( void )
+void unwatch_input( const size_t i )
 {
-    int i, j = 0;
-    if (fprintf(stdout, "%s(", _m_print) < 0) {
-        stop("lost stdout");
-    }
-    while (j || (i = cursor()) != EOF) {
-        if (j) {
-            i = j;
-            j = 0;
+    size_t k, n = 0;
+
+    for (k = 0; k < _watched_len; k++) {
+        if (_watched[k].input == i) {
+            free(_watched[k].dir);
         }
-        switch (i) {
-        case '"':
-            /* dquote string begins */
-            put(i);
-            eat_c_dquote();
-            continue;
-        case '\'':
-            /* squote char begins */
-            put(i);
-            eat_c_squote();
-            continue;
-        case '?':
-            switch ((j = cursor())) {
-            case EOF:
-                stop("eof while scanning C print-string arguments");
-                return;
-            case '>':
-                /* end tag */
-                write(");", 2);
-                return;
-            }
+        else {
+            _watched[n++] = _watched[k];
         }
-        put(i);
     }
-    stop("eof while scanning C print-string arguments");
+    _watched_len = n;
 }
-void eat_c_ml_comment( void )
+#endif /* __linux__ */
+void load_input( void )
 {
-    int i, prev = -1;
-    while ((i = cursor()) != EOF) {
-        put(i);
-        if (i == '/' && prev == '*') {
-            /* end of comment */
+    size_t sz = READSIZE;
+    size_t n;
+#ifndef _MSC_VER
+    struct stat st;
+    const int fd = fileno(_in_file);
+
+    if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0) {
+        /* regular file, map it whole */
+        void *p = mmap(NULL, (size_t) st.st_size, PROT_READ, MAP_PRIVATE,
+                fd, 0);
+        if (p != MAP_FAILED) {
+            madvise(p, (size_t) st.st_size, MADV_SEQUENTIAL);
+            _src = p;
+            _src_len = (size_t) st.st_size;
+            _src_mapped = 1;
             return;
         }
-        prev = i;
     }
-    stop("eof while scanning C multi-line comment");
+#endif
+    /* pipe or terminal, read everything in a growing buffer */
+    if (!(_src = malloc(sz))) {
+        stop("no memory");
+    }
+    while ((n = fread(_src + _src_len, sizeof(char), sz - _src_len,
+                    _in_file)))
+    {
+        _src_len += n;
+        if (_src_len == sz) {
+            sz *= 2;
+            if (!(_src = realloc(_src, sz))) {
+                stop("no memory");
+            }
+        }
+    }
+    if (ferror(_in_file)) {
+        stop("unable to read input");
+    }
 }
-void eat_c_sl_comment( void )
+void unload_input( void )
 {
-    int i;
-    while ((i = cursor()) != EOF) {
-        put(i);
-        if (i == '\n') {
-            /* end of comment */
-            return;
+    if (!_src) {
+        return;
+    }
+#ifndef _MSC_VER
+    if (_src_mapped) {
+        munmap(_src, _src_len);
+    }
+    else
+#endif
+    free(_src);
+    _src = NULL;
+    _src_len = 0;
+    _src_mapped = 0;
+}
+int valid_filepath( const char* fpath )
+{
+    if (!fpath || !*fpath || *fpath == '-' || strlen(fpath) >= 4096) {
+        return 0;
+    }
+    for (; *fpath; fpath++) {
+        if (!strchr(NONDIGIT DIGIT SPECIALCHAR, *fpath)) {
+            return 0;
         }
     }
-    stop("eof while scanning C single-line comment");
+    return 1;
 }
-void eat_c_squote( void )
+void report_stats( void )
 {
-    int i, j = 0;
-    while ((i = cursor()) != EOF) {
-        switch (j) {
-        case 0:
-            switch (i) {
-            case '\'':
-            case '\n':
-                /* invalid chars, etc todo */
-                stop("invalid C single-quoted char");
-            }
-            put(i);
-            if (i == '\\') {
-                j++;
-                continue;
+    const struct nanabozo_stats *const st = nanabozo_stats(_nb);
+    const int json = _stats == STATS_JSON;
+    char buf[16384], name[1024], match[64];
+    size_t len = 0;
+    int i, j;
+
+    /* in one go, other jobs may be reporting too */
+    report_escape(name, sizeof(name), _m_input_file ? _m_input_file : "-");
+    if (json) {
+        report_add(buf, sizeof(buf), &len, "{\"file\":\"%s\",\"phases\":"
+                "{\"read\":{\"wall_ms\":%.3f,\"cpu_ms\":%.3f}", name,
+                _read_wall * 1e3, _read_cpu * 1e3);
+        for (i = 0; i < NANABOZO_PHASES; i++) {
+            report_add(buf, sizeof(buf), &len,
+                    ",\"%s\":{\"wall_ms\":%.3f,\"cpu_ms\":%.3f}",
+                    st->phase[i], st->wall[i] * 1e3, st->cpu[i] * 1e3);
+        }
+        report_add(buf, sizeof(buf), &len, "},\"contexts\":{");
+        for (i = 0; i < NANABOZO_CONTEXTS; i++) {
+            report_add(buf, sizeof(buf), &len, "%s\"%s\":{\"bytes\":%llu,"
+                    "\"hooks\":{", i ? "," : "", st->context[i],
+                    st->bytes[i]);
+            for (j = 0; st->match[i][j]; j++) {
+                report_escape(match, sizeof(match), st->match[i][j]);
+                report_add(buf, sizeof(buf), &len, "%s\"%s\":%lu",
+                        j ? "," : "", match, st->hooks[i][j]);
             }
-            else {
-                j += 2;
-                continue;
+            report_add(buf, sizeof(buf), &len, "}}");
+        }
+        report_add(buf, sizeof(buf), &len, "},\"lines\":%lu,\"skips\":%lu,"
+                "\"compares\":%lu,\"html_regions\":%lu,\"html_bytes\":%llu,"
+                "\"html_peak\":%lu,\"writes\":%lu,\"output_bytes\":%llu}\n",
+                st->lines, st->skips, st->compares, st->flushes, st->flushed,
+                (unsigned long) st->html_peak, st->writes, st->written);
+    }
+    else {
+        report_add(buf, sizeof(buf), &len, "\nnanabozo stats: %s\n"
+                "  %-24s %10s %10s\n  %-24s %10.3f %10.3f\n", name,
+                "phase", "wall ms", "cpu ms", "read", _read_wall * 1e3,
+                _read_cpu * 1e3);
+        for (i = 0; i < NANABOZO_PHASES; i++) {
+            report_add(buf, sizeof(buf), &len, "  %-24s %10.3f %10.3f\n",
+                    st->phase[i], st->wall[i] * 1e3, st->cpu[i] * 1e3);
+        }
+        report_add(buf, sizeof(buf), &len, "  %-24s %10s %10s\n", "context",
+                "bytes", "hooks");
+        for (i = 0; i < NANABOZO_CONTEXTS; i++) {
+            unsigned long hooks = 0;
+            for (j = 0; st->match[i][j]; j++) {
+                hooks += st->hooks[i][j];
             }
-        case 1:
-            put(i);
-            j++;
-            continue;
-        case 2:
-            /* expecting single quote */
-            if (i != '\'') {
-                stop("invalid C single-quoted char");
+            report_add(buf, sizeof(buf), &len, "  %-24s %10llu %10lu\n",
+                    st->context[i], st->bytes[i], hooks);
+            for (j = 0; st->match[i][j]; j++) {
+                if (!st->hooks[i][j]) {
+                    continue;
+                }
+                report_escape(match, sizeof(match), st->match[i][j]);
+                report_add(buf, sizeof(buf), &len, "    \"%s\"%*s %10lu\n",
+                        match, (int) (20 - strlen(match)), "",
+                        st->hooks[i][j]);
             }
-            put(i);
-            return;
         }
+        report_add(buf, sizeof(buf), &len, "  lines %lu, skips %lu,"
+                " compares %lu\n  html regions %lu, bytes %llu, peak %lu\n"
+                "  output writes %lu, bytes %llu\n", st->lines, st->skips,
+                st->compares, st->flushes, st->flushed,
+                (unsigned long) st->html_peak, st->writes, st->written);
     }
-    stop("eof while scanning C single-quoted char");
+    fputs(buf, stderr);
 }
-void eat_html_comment( void )
+void report_cached( void )
 {
-    int i, prev = -1, prev1 = -1;
-    while ((i = cursor()) != EOF) {
-        bufput(i);
-        if (i == '>' && prev == '-' && prev1 == '-') {
-            /* end of comment */
-            return;
-        }
-        prev1 = prev;
-        prev = i;
+    const int json = _stats == STATS_JSON;
+    char name[1024];
+
+    /* nothing scanned, the output is the cached translation */
+    report_escape(name, sizeof(name), _m_input_file ? _m_input_file : "-");
+    if (json) {
+        fprintf(stderr, "{\"file\":\"%s\",\"cached\":true,\"phases\":"
+                "{\"read\":{\"wall_ms\":%.3f,\"cpu_ms\":%.3f}}}\n", name,
+                _read_wall * 1e3, _read_cpu * 1e3);
     }
-    stop("eof while scanning html comment");
-}
-void eat_script_dquote( void )
-{
-    int i, prev = -1;
-    while ((i = cursor()) != EOF) {
-        if (i == '\n') {
-            stop("unexpected newline in script double-quoted string");
-        }
-        bufput(i);
-        if (i == '"' && prev != '\\') {
-            /* end of string */
-            return;
-        }
-        prev = i;
+    else {
+        fprintf(stderr, "\nnanabozo stats: %s\n  from the cache (-k),"
+                " read in %.3f ms wall, %.3f ms cpu\n", name,
+                _read_wall * 1e3, _read_cpu * 1e3);
     }
-    stop("eof while scanning script double-quoted string");
 }
-void eat_script_ml_comment( void )
+void report_add( char *buf, const size_t sz, size_t *len,
+        const char *fmt, ... )
 {
-    int i, prev = -1;
-    while ((i = cursor()) != EOF) {
-        bufput(i);
-        if (i == '/' && prev == '*') {
-            /* end of comment */
-            return;
-        }
-        prev = i;
+    va_list ap;
+    int n;
+
+    if (*len >= sz) {
+        return;
+    }
+    va_start(ap, fmt);
+    n = vsnprintf(buf + *len, sz - *len, fmt, ap);
+    va_end(ap);
+    if (n > 0) {
+        *len += (size_t) n;
     }
-    stop("eof while scanning script multi-line comment");
 }
-void eat_script_sl_comment( void )
+void report_escape( char *dst, const size_t sz, const char *s )
 {
-    int i;
-    while ((i = cursor()) != EOF) {
-        bufput(i);
-        if (i == '\n') {
-            /* end of comment */
-            return;
+    /* quotes, backslashes and controls, as both C and JSON read them */
+    size_t len = 0;
+
+    for (; *s && len + 7 < sz; s++) {
+        switch (*s) {
+        case '"':
+        case '\\':
+            dst[len++] = '\\';
+            dst[len++] = *s;
+            break;
+        case '\n':
+            dst[len++] = '\\';
+            dst[len++] = 'n';
+            break;
+        case '\r':
+            dst[len++] = '\\';
+            dst[len++] = 'r';
+            break;
+        case '\t':
+            dst[len++] = '\\';
+            dst[len++] = 't';
+            break;
+        default:
+            if ((unsigned char) *s < 0x20) {
+                len += (size_t) sprintf(dst + len, "\\u%04x", *s);
+            }
+            else {
+                dst[len++] = *s;
+            }
+            break;
         }
     }
-    stop("eof while scanning script single-line comment");
+    dst[len] = '\0';
 }
-void eat_script_squote( void )
+double wall_clock( void )
 {
-    int i, prev = -1;
-    while ((i = cursor()) != EOF) {
-        if (i == '\n') {
-            stop("unexpected newline in script single-quoted string");
-        }
-        bufput(i);
-        if (i == '\'' && prev != '\\') {
-            /* end of string */
-            return;
-        }
-        prev = i;
-    }
-    stop("eof while scanning script single-quoted string");
+    struct timespec ts;
+
+    timespec_get(&ts, TIME_UTC);
+    return (double) ts.tv_sec + (double) ts.tv_nsec / 1e9;
 }
 void stop( const char* msg )
 {
-    bufout();
-    fputs("\nnanabozo error: ", stderr);
-    fputs(msg, stderr);
-    if (_lineno > 0) {
-        fprintf(stderr, "\n(line: %lu)\n", _lineno);
-    }
-    else {
-        fputc('\n', stderr);
-    }
-    exit(EXIT_FAILURE);
+    stopped(msg);
 }
 void stop2( const char* fmt, ... )
 {
+    char msg[1024];
     va_list ap;
     va_start(ap, fmt);
-    bufout();
+    vsnprintf(msg, sizeof(msg), fmt, ap);
+    va_end(ap);
+    stopped(msg);
+}
+void stopped( const char *msg )
+{
+    discard_output();
+    cache_discard();
+    if (_batch_file) {
+        /* in one go, other jobs may be reporting too */
+        fprintf(stderr, "\nnanabozo error: %s\n(file: %s, line: %lu)\n",
+                msg, _m_input_file, _lineno);
+        longjmp(_batch_env, 1);
+    }
     fputs("\nnanabozo error: ", stderr);
-    vfprintf(stderr, fmt, ap);
+    fputs(msg, stderr);
     if (_lineno > 0) {
         fprintf(stderr, "\n(line: %lu)\n", _lineno);
     }
     else {
         fputc('\n', stderr);
     }
-    va_end(ap);
     exit(EXIT_FAILURE);
 }
 
@@ -0,0 +1,163 @@
+/*
+    nanabozo - tool for CHTML script-coding
+    Copyright (C) 2018-2020 Stanislas Marquis <stan@astrorigin.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+/*
+ *  libnanabozo - CHTML to C translator
+ *
+ *  All state lives in a translator (struct nanabozo), so that translators
+ *  can be used in turn or concurrently, one per thread. Output and included
+ *  file names are handed to callbacks, errors are returned as codes.
+ *  Partials (<?include "name" ?>) are fetched through a callback, and kept
+ *  translated in the translator: the next pages including them reuse the
+ *  code as long as their source is the same.
+ *
+ *      struct nanabozo_options opts = { 0 };
+ *      struct nanabozo *nb = nanabozo_new(&opts);
+ *      nanabozo_set_output(nb, &my_write, my_file);
+ *      if (nanabozo_translate(nb, src, len) != NANABOZO_OK) {
+ *          fprintf(stderr, "%s (line %lu)\n",
+ *                  nanabozo_errmsg(nb), nanabozo_lineno(nb));
+ *      }
+ *      nanabozo_free(nb);
+ */
+
+#ifndef NANABOZO_H
+#define NANABOZO_H
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#ifndef OUTSIZE
+#define OUTSIZE 65536   /* translator output buffer */
+#endif
+
+enum nanabozo_error
+{
+    NANABOZO_OK = 0,
+    NANABOZO_ESCRIPT,   /* error in the script, see message and line */
+    NANABOZO_EREAD,     /* read callback failed */
+    NANABOZO_EWRITE,    /* write callback failed */
+    NANABOZO_ECALLBACK, /* include or partial callback aborted translation */
+    NANABOZO_EINVAL,    /* invalid option */
+    NANABOZO_ENOMEM     /* out of memory */
+};
+
+/* translation options, strings must outlive the translator */
+struct nanabozo_options
+{
+    int mainfunc;       /* turn input into the body of a main function */
+    int send_headers;   /* print content-type header */
+    int no_comments;    /* omit all begin/end comments */
+    int line_buffered;  /* flush output at each newline */
+    int deterministic;  /* omit the date from the top comment */
+    const char *comment;    /* top comment, NULL for default, "" for none */
+    const char *prefix;     /* string to prepend, or NULL */
+    const char *suffix;     /* string to append, or NULL */
+    const char *print;      /* print function, NULL defines print(x) */
+    const char *printf;     /* printf function, NULL for printf */
+    int sized;          /* pass the length of html literals to print_n */
+    const char *print_n;    /* print_n function, NULL for print + "_n" */
+    int writev;         /* generated code collects output for writev */
+    int buffer;         /* generated code uses nanabozo_buffer.h */
+    int fastcgi;        /* input is the body of a FastCGI request loop */
+    int minify;         /* drop html, script and style comments and spaces */
+    int compile_formats;    /* split literal printf formats (nanabozo_format.h) */
+    const char *cxx;    /* C++ page template of that name (nanabozo_cxx.h) */
+    int stats;          /* count translator internals (nanabozo_stats) */
+    int profile_regions;    /* time print regions (nanabozo_profile.h) */
+};
+
+#define NANABOZO_CONTEXTS 5 /* html, c, script, style, tag */
+#define NANABOZO_MATCHES 32 /* entries of a context table, at most */
+#define NANABOZO_PHASES 3   /* setup, scan, finish */
+
+/* counters of the last translation, partials scanned included */
+struct nanabozo_stats
+{
+    const char *context[NANABOZO_CONTEXTS];     /* names */
+    const char *match[NANABOZO_CONTEXTS][NANABOZO_MATCHES]; /* NULL ended */
+    const char *phase[NANABOZO_PHASES];         /* names */
+    unsigned long long bytes[NANABOZO_CONTEXTS];    /* scanned in context */
+    unsigned long hooks[NANABOZO_CONTEXTS][NANABOZO_MATCHES];  /* by entry */
+    unsigned long skips;        /* jumps to a leading byte of the context */
+    unsigned long compares;     /* entries compared at a leading byte */
+    unsigned long lines;        /* input lines read */
+    unsigned long flushes;      /* html regions printed */
+    unsigned long long flushed; /* html bytes printed */
+    size_t html_peak;           /* largest html region buffered */
+    unsigned long writes;       /* calls to the write callback */
+    unsigned long long written; /* output bytes */
+    double wall[NANABOZO_PHASES];   /* seconds, by phase */
+    double cpu[NANABOZO_PHASES];    /* seconds of processor time */
+};
+
+/* return number of bytes read, 0 at end of input, -1 on error */
+typedef long (*nanabozo_read_fn)( void *arg, char *buf, size_t sz );
+/* return 0, or -1 on error */
+typedef int (*nanabozo_write_fn)( void *arg, const char *s, size_t len );
+/* quoted include (#include "name") met in C code, return 0 to go on */
+typedef int (*nanabozo_include_fn)( void *arg, const char *name, size_t len );
+/* partial (<?include "name" ?>) met in html, return 0 and its source */
+typedef int (*nanabozo_partial_fn)( void *arg, const char *name, size_t len,
+        const char **src, size_t *srclen );
+
+struct nanabozo;
+
+/* create a translator, NULL if out of memory */
+struct nanabozo *nanabozo_new( const struct nanabozo_options *opts );
+void nanabozo_free( struct nanabozo *nb );
+
+/* output goes to stdout by default */
+void nanabozo_set_output( struct nanabozo *nb,
+        nanabozo_write_fn fn, void *arg );
+/* name of the next scripts (NANABOZO_PROFILE_FILE), NULL by default */
+void nanabozo_set_name( struct nanabozo *nb, const char *name );
+/* includes are not scanned by default */
+void nanabozo_set_includes( struct nanabozo *nb,
+        nanabozo_include_fn fn, void *arg );
+/* partials are refused by default, sources must last until translated */
+void nanabozo_set_partials( struct nanabozo *nb,
+        nanabozo_partial_fn fn, void *arg );
+
+/* translate a script held in memory */
+int nanabozo_translate( struct nanabozo *nb, const char *src, size_t len );
+/* translate a script read through a callback */
+int nanabozo_translate_stream( struct nanabozo *nb,
+        nanabozo_read_fn fn, void *arg );
+
+/* last error message and script line (0 if none) */
+const char *nanabozo_errmsg( const struct nanabozo *nb );
+unsigned long nanabozo_lineno( const struct nanabozo *nb );
+
+/* counters of the last translation, NULL without the option stats */
+const struct nanabozo_stats *nanabozo_stats( const struct nanabozo *nb );
+
+/* non-zero if id can be used as print or printf function */
+int nanabozo_valid_identifier( const char *id );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* NANABOZO_H */
+
+/* vi: set fenc=utf-8 ff=unix sw=4 ts=4 sts=4 et ai : */
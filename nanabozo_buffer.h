@@ -0,0 +1,235 @@
+/*
+    nanabozo - tool for CHTML script-coding
+    Copyright (C) 2018-2020 Stanislas Marquis <stan@astrorigin.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+/*
+ *  nanabozo_buffer - response buffer for generated pages (C99 or C++)
+ *
+ *  The page is built in a growable buffer, formatted output is written in
+ *  place, and the response is sent with a single writev: headers, then
+ *  an exact Content-Length, then the body, without copying it again.
+ *  This is what the option --buffer uses, it can also be used directly:
+ *
+ *      struct nanabozo_buffer head = NANABOZO_BUFFER_INIT;
+ *      struct nanabozo_buffer body = NANABOZO_BUFFER_INIT;
+ *      nanabozo_buffer_puts(&head, "Content-Type: text/html\n");
+ *      nanabozo_buffer_printf(&body, "<p>%d</p>\n", 42);
+ *      nanabozo_buffer_send(&head, &body, 1);
+ *      nanabozo_buffer_free(&head);
+ *      nanabozo_buffer_free(&body);
+ *
+ *  Allocation failures are sticky: the buffer ignores further output and
+ *  nanabozo_buffer_send sends nothing, so that no truncated page goes out.
+ */
+
+#ifndef NANABOZO_BUFFER_H
+#define NANABOZO_BUFFER_H
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef _WIN32
+#include <errno.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#endif
+
+#ifndef NANABOZO_BUFFER_SIZE
+#define NANABOZO_BUFFER_SIZE 65536  /* first allocation */
+#endif
+
+struct nanabozo_buffer
+{
+    char *data;
+    size_t len;
+    size_t cap;
+    int failed;
+};
+
+#define NANABOZO_BUFFER_INIT { NULL, 0, 0, 0 }
+
+/* make room for n more bytes, return 0, or -1 if out of memory */
+static inline int nanabozo_buffer_reserve( struct nanabozo_buffer *b,
+        size_t n )
+{
+    size_t cap;
+    char *p;
+    if (b->failed) {
+        return -1;
+    }
+    if (b->cap - b->len >= n) {
+        return 0;
+    }
+    cap = b->cap ? b->cap : NANABOZO_BUFFER_SIZE;
+    while (cap - b->len < n) {
+        if (cap > (size_t) -1 / 2) {
+            b->failed = 1;
+            return -1;
+        }
+        cap *= 2;
+    }
+    if (!(p = (char *) realloc(b->data, cap))) {
+        b->failed = 1;
+        return -1;
+    }
+    b->data = p;
+    b->cap = cap;
+    return 0;
+}
+
+static inline void nanabozo_buffer_put( struct nanabozo_buffer *b,
+        const char *s, size_t n )
+{
+    if (b->cap - b->len < n && nanabozo_buffer_reserve(b, n) != 0) {
+        return;
+    }
+    memcpy(b->data + b->len, s, n);
+    b->len += n;
+}
+
+static inline void nanabozo_buffer_puts( struct nanabozo_buffer *b,
+        const char *s )
+{
+    nanabozo_buffer_put(b, s, strlen(s));
+}
+
+/* format in place, return the number of bytes added, or -1 */
+static inline int nanabozo_buffer_vprintf( struct nanabozo_buffer *b,
+        const char *fmt, va_list ap )
+{
+    va_list ap2;
+    int n;
+    if (b->failed) {
+        return -1;
+    }
+    va_copy(ap2, ap);
+    n = vsnprintf(b->data + b->len, b->cap - b->len, fmt, ap2);
+    va_end(ap2);
+    if (n < 0) {
+        return n;
+    }
+    if ((size_t) n >= b->cap - b->len) {
+        if (nanabozo_buffer_reserve(b, (size_t) n + 1) != 0) {
+            return -1;
+        }
+        vsnprintf(b->data + b->len, b->cap - b->len, fmt, ap);
+    }
+    b->len += (size_t) n;
+    return n;
+}
+
+static inline int nanabozo_buffer_printf( struct nanabozo_buffer *b,
+        const char *fmt, ... )
+{
+    va_list ap;
+    int n;
+    va_start(ap, fmt);
+    n = nanabozo_buffer_vprintf(b, fmt, ap);
+    va_end(ap);
+    return n;
+}
+
+/* empty the buffer, keeping its memory */
+static inline void nanabozo_buffer_reset( struct nanabozo_buffer *b )
+{
+    b->len = 0;
+    b->failed = 0;
+}
+
+static inline void nanabozo_buffer_free( struct nanabozo_buffer *b )
+{
+    free(b->data);
+    b->data = NULL;
+    b->len = b->cap = 0;
+    b->failed = 0;
+}
+
+#ifndef _WIN32
+/* write all of iov to fd, return 0, or -1 on error (iov is modified) */
+static inline int nanabozo_buffer_writev( int fd, struct iovec *iov, int cnt )
+{
+    ssize_t n;
+    while (cnt > 0) {
+        if ((n = writev(fd, iov, cnt)) < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return -1;
+        }
+        for (; cnt > 0 && (size_t) n >= iov->iov_len; iov++, cnt--) {
+            n -= (ssize_t) iov->iov_len;
+        }
+        if (cnt > 0) {
+            iov->iov_base = (char *) iov->iov_base + n;
+            iov->iov_len -= (size_t) n;
+        }
+    }
+    return 0;
+}
+#endif
+
+/*
+ *  Send the response to fd: if there are headers (head may be NULL), they
+ *  are followed by the Content-Length of body and an empty line.
+ *  Return 0, or -1 on error (nothing is sent after a failed allocation).
+ */
+static inline int nanabozo_buffer_send( const struct nanabozo_buffer *head,
+        const struct nanabozo_buffer *body, int fd )
+{
+    char length[48];
+#ifndef _WIN32
+    struct iovec iov[3];
+    int cnt = 0;
+#endif
+    if ((head && head->failed) || body->failed) {
+        return -1;
+    }
+    snprintf(length, sizeof(length), "Content-Length: %lu\n\n",
+            (unsigned long) body->len);
+#ifndef _WIN32
+    if (head && head->len) {
+        iov[cnt].iov_base = head->data;
+        iov[cnt++].iov_len = head->len;
+        iov[cnt].iov_base = length;
+        iov[cnt++].iov_len = strlen(length);
+    }
+    if (body->len) {
+        iov[cnt].iov_base = body->data;
+        iov[cnt++].iov_len = body->len;
+    }
+    return nanabozo_buffer_writev(fd, iov, cnt);
+#else
+    (void) fd;
+    if (head && head->len
+        && (fwrite(head->data, 1, head->len, stdout) != head->len
+            || fputs(length, stdout) == EOF))
+    {
+        return -1;
+    }
+    if (fwrite(body->data, 1, body->len, stdout) != body->len) {
+        return -1;
+    }
+    return fflush(stdout) == 0 ? 0 : -1;
+#endif
+}
+
+#endif /* NANABOZO_BUFFER_H */
+
+/* vi: set fenc=utf-8 ff=unix sw=4 ts=4 sts=4 et ai : */
@@ -0,0 +1,135 @@
+/*
+    nanabozo - tool for CHTML script-coding
+    Copyright (C) 2018-2020 Stanislas Marquis <stan@astrorigin.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+/*
+ *  nanabozo_cxx - output of C++ page templates (C++17)
+ *
+ *  With the option --cxx, the page is a function template over its sink,
+ *  any type with a write(const char *, size_t) member. The sink is known
+ *  where the page is instantiated, so that its writes can be inlined:
+ *
+ *      struct my_sink
+ *      {
+ *          std::string body;
+ *          void write(const char *s, size_t n) { body.append(s, n); }
+ *      };
+ *      my_sink out;
+ *      nanabozo_page(out);
+ *
+ *  Literals are written as string views, and <?= ?> values are written
+ *  with their length when their type knows it (std::string, string_view).
+ */
+
+#ifndef NANABOZO_CXX_H
+#define NANABOZO_CXX_H
+
+#include <cstdarg>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <string_view>
+
+namespace nanabozo {
+
+/* stdout, through stdio buffers */
+struct stdout_sink
+{
+    void write( const char *s, std::size_t n )
+    {
+        std::fwrite(s, 1, n, stdout);
+    }
+};
+
+/* whole page in a string */
+struct string_sink
+{
+    std::string str;
+    void write( const char *s, std::size_t n )
+    {
+        str.append(s, n);
+    }
+};
+
+/* literals, length known at translation time */
+template <class Sink>
+inline void write( Sink &sink, std::string_view s )
+{
+    sink.write(s.data(), s.size());
+}
+
+/* <?= ?> values */
+template <class Sink>
+inline void print( Sink &sink, std::string_view s )
+{
+    sink.write(s.data(), s.size());
+}
+template <class Sink>
+inline void print( Sink &sink, const std::string &s )
+{
+    sink.write(s.data(), s.size());
+}
+template <class Sink>
+inline void print( Sink &sink, const char *s )
+{
+    if (s) {
+        sink.write(s, std::strlen(s));
+    }
+}
+template <class Sink>
+inline void print( Sink &sink, char c )
+{
+    sink.write(&c, 1);
+}
+
+/* vsnprintf, that takes formats without arguments quietly */
+inline int format( char *buf, std::size_t sz, const char *fmt, ... )
+{
+    va_list ap;
+    va_start(ap, fmt);
+    const int n = std::vsnprintf(buf, sz, fmt, ap);
+    va_end(ap);
+    return n;
+}
+
+/* <?% ?> formats, on the stack, or in a string when longer */
+template <class Sink, class... Args>
+inline int printf( Sink &sink, const char *fmt, Args... args )
+{
+    char buf[256];
+    const int n = format(buf, sizeof(buf), fmt, args...);
+    if (n < 0) {
+        return n;
+    }
+    if ((std::size_t) n < sizeof(buf)) {
+        sink.write(buf, (std::size_t) n);
+    }
+    else {
+        std::string s((std::size_t) n, '\0');
+        format(s.data(), s.size() + 1, fmt, args...);
+        sink.write(s.data(), s.size());
+    }
+    return n;
+}
+
+} /* namespace nanabozo */
+
+#endif /* NANABOZO_CXX_H */
+
+/* vi: set fenc=utf-8 ff=unix sw=4 ts=4 sts=4 et ai : */
@@ -0,0 +1,232 @@
+/*
+    nanabozo - tool for CHTML script-coding
+    Copyright (C) 2018-2020 Stanislas Marquis <stan@astrorigin.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+/*
+ *  nanabozo_escape - escapers for the <?- ?> tag (C99 or C++)
+ *
+ *  The translator picks one escaper per call site, from where the tag is:
+ *  html text (& < >), quoted attribute value (& < > " '), script (as the
+ *  content of a javascript string), or event handler attribute (a script
+ *  string that the html decoding leaves as is). Clean spans are found 16
+ *  bytes at a time with SSE2, and the escaped text is produced in chunks:
+ *
+ *      struct nanabozo_escape e;
+ *      nanabozo_escape_init(&e, name);
+ *      while (nanabozo_escape_html(&e)) {
+ *          fwrite(e.out, 1, e.len, stdout);
+ *      }
+ */
+
+#ifndef NANABOZO_ESCAPE_H
+#define NANABOZO_ESCAPE_H
+
+#include <stddef.h>
+#include <string.h>
+
+#if defined(__SSE2__) && defined(__GNUC__)
+#include <emmintrin.h>
+#define NANABOZO_ESCAPE_SSE2 1
+#endif
+
+#ifndef NANABOZO_ESCAPE_CHUNK
+#define NANABOZO_ESCAPE_CHUNK 1024  /* escaped bytes per chunk */
+#endif
+
+#define NANABOZO_ESCAPE_HTML    1
+#define NANABOZO_ESCAPE_ATTR    2
+#define NANABOZO_ESCAPE_JS      4
+
+struct nanabozo_escape
+{
+    const char *s;
+    const char *end;
+    size_t len;     /* length of out */
+    char out[NANABOZO_ESCAPE_CHUNK + 8];
+};
+
+/* chars to escape, by context (bit 1 html, 2 attr, 4 js) */
+static const unsigned char nanabozo_escape_class[256] =
+{
+    4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4,
+    4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4,
+    0, 0, 6, 0, 4, 0, 7, 6, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 7, 0, 7, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 4, 0, 0, 0,
+    4, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 4, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0
+};
+
+static inline void nanabozo_escape_init( struct nanabozo_escape *e,
+        const char *s )
+{
+    e->s = s ? s : "";
+    e->end = e->s + strlen(e->s);
+    e->len = 0;
+}
+
+/* number of bytes that need no escaping */
+static inline size_t nanabozo_escape_span( const char *s, const char *end,
+        const int mask )
+{
+    const char *p = s;
+#ifdef NANABOZO_ESCAPE_SSE2
+    const __m128i amp = _mm_set1_epi8('&');
+    const __m128i lt = _mm_set1_epi8('<');
+    const __m128i gt = _mm_set1_epi8('>');
+    const __m128i dq = _mm_set1_epi8('"');
+    const __m128i sq = _mm_set1_epi8('\'');
+    const __m128i bs = _mm_set1_epi8('\\');
+    const __m128i bq = _mm_set1_epi8('`');
+    const __m128i dollar = _mm_set1_epi8('$');
+    const __m128i ctl = _mm_set1_epi8(0x1f);
+    const __m128i e2 = _mm_set1_epi8((char) 0xe2);
+    while (end - p >= 16) {
+        const __m128i v = _mm_loadu_si128((const __m128i *) p);
+        __m128i m = _mm_or_si128(_mm_cmpeq_epi8(v, amp),
+                _mm_or_si128(_mm_cmpeq_epi8(v, lt), _mm_cmpeq_epi8(v, gt)));
+        int bits;
+        if (mask & (NANABOZO_ESCAPE_ATTR | NANABOZO_ESCAPE_JS)) {
+            m = _mm_or_si128(m, _mm_or_si128(_mm_cmpeq_epi8(v, dq),
+                        _mm_cmpeq_epi8(v, sq)));
+        }
+        if (mask & NANABOZO_ESCAPE_JS) {
+            /* v <= 0x1f, unsigned */
+            m = _mm_or_si128(m, _mm_cmpeq_epi8(_mm_max_epu8(v, ctl), ctl));
+            m = _mm_or_si128(m, _mm_or_si128(_mm_cmpeq_epi8(v, bs),
+                        _mm_cmpeq_epi8(v, bq)));
+            m = _mm_or_si128(m, _mm_or_si128(_mm_cmpeq_epi8(v, dollar),
+                        _mm_cmpeq_epi8(v, e2)));
+        }
+        if ((bits = _mm_movemask_epi8(m))) {
+            return (size_t) (p - s) + (size_t) __builtin_ctz((unsigned) bits);
+        }
+        p += 16;
+    }
+#endif
+    while (p != end && !(nanabozo_escape_class[(unsigned char) *p] & mask)) {
+        p++;
+    }
+    return (size_t) (p - s);
+}
+
+/* escape the next chunk in e->out (nul terminated), return its length */
+static inline size_t nanabozo_escape_next( struct nanabozo_escape *e,
+        const int mask )
+{
+    static const char hex[] = "0123456789ABCDEF";
+    char *o = e->out;
+    char *const limit = e->out + NANABOZO_ESCAPE_CHUNK;
+
+    while (e->s != e->end && o < limit) {
+        size_t n = nanabozo_escape_span(e->s, e->end, mask);
+        unsigned char c;
+        if (n > (size_t) (limit - o)) {
+            n = (size_t) (limit - o);
+        }
+        memcpy(o, e->s, n);
+        o += n;
+        e->s += n;
+        if (e->s == e->end || o == limit) {
+            break;
+        }
+        /* one char to escape, at most 6 bytes (out has 8 more) */
+        c = (unsigned char) *e->s++;
+        if (!(mask & NANABOZO_ESCAPE_JS)) {
+            const char *ent = c == '&' ? "&amp;" : c == '<' ? "&lt;"
+                : c == '>' ? "&gt;" : c == '"' ? "&quot;" : "&#39;";
+            const size_t len = strlen(ent);
+            memcpy(o, ent, len);
+            o += len;
+        }
+        else if (c == 0xe2) {
+            /* line and paragraph separators end javascript lines */
+            if (e->end - e->s >= 2 && (unsigned char) e->s[0] == 0x80
+                && ((unsigned char) e->s[1] & 0xfe) == 0xa8)
+            {
+                memcpy(o, e->s[1] == (char) 0xa8 ? "\\u2028" : "\\u2029", 6);
+                o += 6;
+                e->s += 2;
+            }
+            else {
+                *o++ = (char) c;
+            }
+        }
+        else if ((c == '"' || c == '\'') && (mask & NANABOZO_ESCAPE_ATTR)) {
+            /* no quote, nor entity, in an attribute value */
+            *o++ = '\\';
+            *o++ = 'x';
+            *o++ = hex[c >> 4];
+            *o++ = hex[c & 15];
+        }
+        else if (c == '\\' || c == '"' || c == '\'') {
+            *o++ = '\\';
+            *o++ = (char) c;
+        }
+        else if (c == '\n') {
+            *o++ = '\\';
+            *o++ = 'n';
+        }
+        else {
+            /* < > & ` $ and control chars */
+            *o++ = '\\';
+            *o++ = 'x';
+            *o++ = hex[c >> 4];
+            *o++ = hex[c & 15];
+        }
+    }
+    *o = '\0';
+    return e->len = (size_t) (o - e->out);
+}
+
+/* html text: & < > */
+static inline size_t nanabozo_escape_html( struct nanabozo_escape *e )
+{
+    return nanabozo_escape_next(e, NANABOZO_ESCAPE_HTML);
+}
+
+/* quoted attribute value: & < > " ' */
+static inline size_t nanabozo_escape_attr( struct nanabozo_escape *e )
+{
+    return nanabozo_escape_next(e, NANABOZO_ESCAPE_ATTR);
+}
+
+/* content of a javascript string, safe inside <script> */
+static inline size_t nanabozo_escape_js( struct nanabozo_escape *e )
+{
+    return nanabozo_escape_next(e, NANABOZO_ESCAPE_JS);
+}
+
+/* javascript string in an event handler attribute value */
+static inline size_t nanabozo_escape_js_attr( struct nanabozo_escape *e )
+{
+    return nanabozo_escape_next(e, NANABOZO_ESCAPE_JS | NANABOZO_ESCAPE_ATTR);
+}
+
+#endif /* NANABOZO_ESCAPE_H */
+
+/* vi: set fenc=utf-8 ff=unix sw=4 ts=4 sts=4 et ai : */
@@ -0,0 +1,568 @@
+/*
+    nanabozo - tool for CHTML script-coding
+    Copyright (C) 2018-2020 Stanislas Marquis <stan@astrorigin.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+/*
+ *  nanabozo_fastcgi - FastCGI responder for generated pages (C99 or C++)
+ *
+ *  A page translated with --fastcgi becomes a request function, called by
+ *  nanabozo_fastcgi_run for each request of a persistent process. Requests
+ *  are served one at a time, connections are kept alive when the web
+ *  server asks for it. Output is built in a response buffer (see
+ *  nanabozo_buffer.h) and sent in FCGI_STDOUT records with writev.
+ *
+ *  The listening socket is the one inherited on descriptor 0, as started
+ *  by the web server or spawn-fcgi, or the address in the environment
+ *  variable NANABOZO_FASTCGI: a unix socket path (with a slash), or
+ *  [host]:port.
+ *
+ *      NANABOZO_FASTCGI=/tmp/page.sock ./page &
+ *      fastcgi_client /tmp/page.sock QUERY_STRING=a=1
+ */
+
+#ifndef NANABOZO_FASTCGI_H
+#define NANABOZO_FASTCGI_H
+
+#include "nanabozo_buffer.h"
+
+#include <netdb.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+/* record types and status, see the FastCGI specification */
+#define NANABOZO_FCGI_BEGIN_REQUEST         1
+#define NANABOZO_FCGI_ABORT_REQUEST         2
+#define NANABOZO_FCGI_END_REQUEST           3
+#define NANABOZO_FCGI_PARAMS                4
+#define NANABOZO_FCGI_STDIN                 5
+#define NANABOZO_FCGI_STDOUT                6
+#define NANABOZO_FCGI_GET_VALUES            9
+#define NANABOZO_FCGI_GET_VALUES_RESULT     10
+#define NANABOZO_FCGI_UNKNOWN_TYPE          11
+#define NANABOZO_FCGI_RESPONDER             1
+#define NANABOZO_FCGI_KEEP_CONN             1
+#define NANABOZO_FCGI_REQUEST_COMPLETE      0
+#define NANABOZO_FCGI_CANT_MPX_CONN         1
+#define NANABOZO_FCGI_UNKNOWN_ROLE          3
+
+#define NANABOZO_FCGI_MAX_CONTENT   65535
+#define NANABOZO_FCGI_IOV           64  /* iovec entries per writev */
+
+struct nanabozo_fastcgi
+{
+    int fd;                 /* connection */
+    unsigned id;            /* current request, 0 if none */
+    int keep_conn;          /* web server keeps the connection */
+    int params_done;
+    struct nanabozo_buffer params;  /* raw name-value pairs */
+    struct nanabozo_buffer env;     /* name\0value\0... */
+    struct nanabozo_buffer input;   /* request body */
+    size_t rpos;            /* read buffer */
+    size_t rlen;
+    unsigned char rbuf[16384];
+    unsigned char rec[NANABOZO_FCGI_MAX_CONTENT + 256];
+};
+
+static struct nanabozo_fastcgi nanabozo_fastcgi_conn;
+
+/* value of a request parameter, NULL if absent */
+static inline const char *nanabozo_fastcgi_param( const char *name )
+{
+    const struct nanabozo_buffer *env = &nanabozo_fastcgi_conn.env;
+    size_t i = 0;
+    while (i < env->len) {
+        const char *n = env->data + i;
+        size_t len = strlen(n);
+        if (!strcmp(n, name)) {
+            return n + len + 1;
+        }
+        i += len + 1;
+        i += strlen(env->data + i) + 1;
+    }
+    return NULL;
+}
+
+/* request body (FCGI_STDIN), nul terminated */
+static inline const char *nanabozo_fastcgi_input( size_t *len )
+{
+    const struct nanabozo_buffer *input = &nanabozo_fastcgi_conn.input;
+    if (len) {
+        *len = input->len;
+    }
+    return input->data ? input->data : "";
+}
+
+/* return 0, or -1 at end of connection */
+static int nanabozo_fastcgi_read( struct nanabozo_fastcgi *c,
+        unsigned char *p, size_t n )
+{
+    while (n) {
+        size_t k;
+        if (c->rpos == c->rlen) {
+            ssize_t r = read(c->fd, c->rbuf, sizeof(c->rbuf));
+            if (r < 0 && errno == EINTR) {
+                continue;
+            }
+            if (r <= 0) {
+                return -1;
+            }
+            c->rpos = 0;
+            c->rlen = (size_t) r;
+        }
+        k = c->rlen - c->rpos < n ? c->rlen - c->rpos : n;
+        memcpy(p, c->rbuf + c->rpos, k);
+        c->rpos += k;
+        p += k;
+        n -= k;
+    }
+    return 0;
+}
+
+static void nanabozo_fastcgi_header( unsigned char *h, int type,
+        unsigned id, size_t len )
+{
+    h[0] = 1;
+    h[1] = (unsigned char) type;
+    h[2] = (unsigned char) (id >> 8);
+    h[3] = (unsigned char) id;
+    h[4] = (unsigned char) (len >> 8);
+    h[5] = (unsigned char) len;
+    h[6] = 0;
+    h[7] = 0;
+}
+
+static int nanabozo_fastcgi_record( struct nanabozo_fastcgi *c, int type,
+        unsigned id, const void *p, size_t len )
+{
+    unsigned char h[8];
+    struct iovec iov[2];
+    nanabozo_fastcgi_header(h, type, id, len);
+    iov[0].iov_base = h;
+    iov[0].iov_len = 8;
+    iov[1].iov_base = (void *) p;
+    iov[1].iov_len = len;
+    return nanabozo_buffer_writev(c->fd, iov, len ? 2 : 1);
+}
+
+static int nanabozo_fastcgi_end( struct nanabozo_fastcgi *c, unsigned id,
+        int status, int protocol )
+{
+    unsigned char b[8] = { 0 };
+    b[0] = (unsigned char) ((unsigned) status >> 24);
+    b[1] = (unsigned char) ((unsigned) status >> 16);
+    b[2] = (unsigned char) ((unsigned) status >> 8);
+    b[3] = (unsigned char) status;
+    b[4] = (unsigned char) protocol;
+    return nanabozo_fastcgi_record(c, NANABOZO_FCGI_END_REQUEST, id, b, 8);
+}
+
+/* length of a name or value, -1 if truncated */
+static long nanabozo_fastcgi_length( const unsigned char *p, size_t len,
+        size_t *i )
+{
+    long n;
+    if (*i >= len) {
+        return -1;
+    }
+    if (!(p[*i] & 0x80)) {
+        return p[(*i)++];
+    }
+    if (*i + 4 > len) {
+        return -1;
+    }
+    n = ((long) (p[*i] & 0x7f) << 24) | ((long) p[*i + 1] << 16)
+        | ((long) p[*i + 2] << 8) | p[*i + 3];
+    *i += 4;
+    return n;
+}
+
+/* decode name-value pairs in env, return 0, or -1 if malformed */
+static int nanabozo_fastcgi_pairs( const unsigned char *p, size_t len,
+        struct nanabozo_buffer *env )
+{
+    size_t i = 0;
+    nanabozo_buffer_reset(env);
+    while (i < len) {
+        long nlen = nanabozo_fastcgi_length(p, len, &i);
+        long vlen = nanabozo_fastcgi_length(p, len, &i);
+        if (nlen < 0 || vlen < 0 || (size_t) nlen > len - i
+            || (size_t) vlen > len - i - (size_t) nlen)
+        {
+            return -1;
+        }
+        nanabozo_buffer_put(env, (const char *) p + i, (size_t) nlen);
+        nanabozo_buffer_put(env, "", 1);
+        nanabozo_buffer_put(env, (const char *) p + i + nlen, (size_t) vlen);
+        nanabozo_buffer_put(env, "", 1);
+        i += (size_t) (nlen + vlen);
+    }
+    return env->failed ? -1 : 0;
+}
+
+/* answer FCGI_GET_VALUES: one connection, one request at a time */
+static int nanabozo_fastcgi_values( struct nanabozo_fastcgi *c,
+        const unsigned char *p, size_t len )
+{
+    static const char *const values[] = {
+        "FCGI_MAX_CONNS", "1", "FCGI_MAX_REQS", "1", "FCGI_MPXS_CONNS", "0"
+    };
+    struct nanabozo_buffer names = NANABOZO_BUFFER_INIT;
+    struct nanabozo_buffer result = NANABOZO_BUFFER_INIT;
+    size_t i, j;
+    int ret;
+    if (nanabozo_fastcgi_pairs(p, len, &names) != 0) {
+        nanabozo_buffer_free(&names);
+        return -1;
+    }
+    for (i = 0; i < names.len; i += strlen(names.data + i) + 1) {
+        for (j = 0; j < sizeof(values) / sizeof(*values); j += 2) {
+            if (!strcmp(names.data + i, values[j])) {
+                unsigned char h[2];
+                h[0] = (unsigned char) strlen(values[j]);
+                h[1] = 1;
+                nanabozo_buffer_put(&result, (const char *) h, 2);
+                nanabozo_buffer_puts(&result, values[j]);
+                nanabozo_buffer_puts(&result, values[j + 1]);
+            }
+        }
+        i += strlen(names.data + i) + 1;
+    }
+    ret = result.failed ? -1 : nanabozo_fastcgi_record(c,
+            NANABOZO_FCGI_GET_VALUES_RESULT, 0, result.data, result.len);
+    nanabozo_buffer_free(&names);
+    nanabozo_buffer_free(&result);
+    return ret;
+}
+
+/* read records until a request is complete, return 0 at end of connection */
+static int nanabozo_fastcgi_accept( struct nanabozo_fastcgi *c )
+{
+    for (;;) {
+        unsigned char h[8];
+        unsigned char *rec = c->rec;
+        unsigned id;
+        size_t len;
+        int type;
+        if (nanabozo_fastcgi_read(c, h, 8) != 0 || h[0] != 1) {
+            return 0;
+        }
+        type = h[1];
+        id = ((unsigned) h[2] << 8) | h[3];
+        len = ((size_t) h[4] << 8) | h[5];
+        if (nanabozo_fastcgi_read(c, rec, len + h[6]) != 0) {
+            return 0;
+        }
+        if (id == 0) {
+            /* management record */
+            if (type == NANABOZO_FCGI_GET_VALUES) {
+                if (nanabozo_fastcgi_values(c, rec, len) != 0) {
+                    return 0;
+                }
+            }
+            else {
+                unsigned char b[8] = { 0 };
+                b[0] = (unsigned char) type;
+                if (nanabozo_fastcgi_record(c,
+                        NANABOZO_FCGI_UNKNOWN_TYPE, 0, b, 8) != 0)
+                {
+                    return 0;
+                }
+            }
+            continue;
+        }
+        switch (type) {
+        case NANABOZO_FCGI_BEGIN_REQUEST:
+            if (len < 8) {
+                return 0;
+            }
+            if (c->id) {
+                if (nanabozo_fastcgi_end(c, id, 0,
+                        NANABOZO_FCGI_CANT_MPX_CONN) != 0)
+                {
+                    return 0;
+                }
+            }
+            else if ((((unsigned) rec[0] << 8) | rec[1])
+                    != NANABOZO_FCGI_RESPONDER)
+            {
+                if (nanabozo_fastcgi_end(c, id, 0,
+                        NANABOZO_FCGI_UNKNOWN_ROLE) != 0)
+                {
+                    return 0;
+                }
+            }
+            else {
+                c->id = id;
+                c->keep_conn = rec[2] & NANABOZO_FCGI_KEEP_CONN;
+                c->params_done = 0;
+                nanabozo_buffer_reset(&c->params);
+                nanabozo_buffer_reset(&c->env);
+                nanabozo_buffer_reset(&c->input);
+            }
+            break;
+        case NANABOZO_FCGI_ABORT_REQUEST:
+            if (id == c->id) {
+                c->id = 0;
+                if (nanabozo_fastcgi_end(c, id, 0,
+                        NANABOZO_FCGI_REQUEST_COMPLETE) != 0
+                    || !c->keep_conn)
+                {
+                    return 0;
+                }
+            }
+            break;
+        case NANABOZO_FCGI_PARAMS:
+            if (id != c->id || c->params_done) {
+                break;
+            }
+            if (len) {
+                nanabozo_buffer_put(&c->params, (const char *) rec, len);
+            }
+            else if (nanabozo_fastcgi_pairs((unsigned char *) c->params.data,
+                        c->params.len, &c->env) != 0)
+            {
+                return 0;
+            }
+            else {
+                c->params_done = 1;
+            }
+            break;
+        case NANABOZO_FCGI_STDIN:
+            if (id != c->id || !c->params_done) {
+                break;
+            }
+            if (len) {
+                nanabozo_buffer_put(&c->input, (const char *) rec, len);
+                break;
+            }
+            /* keep the body nul terminated */
+            nanabozo_buffer_put(&c->input, "", 1);
+            if (c->input.failed) {
+                return 0;
+            }
+            c->input.len--;
+            return 1;
+        default:
+            /* FCGI_DATA and others are ignored */
+            break;
+        }
+    }
+}
+
+/* send head, Content-Length and body in FCGI_STDOUT records, then end */
+static int nanabozo_fastcgi_respond( struct nanabozo_fastcgi *c,
+        const struct nanabozo_buffer *head, const struct nanabozo_buffer *body,
+        int status )
+{
+    static const char error[] = "Status: 500 Internal Server Error\n\n";
+    struct iovec iov[NANABOZO_FCGI_IOV];
+    unsigned char hdrs[NANABOZO_FCGI_IOV / 2][8];
+    unsigned char end[24] = { 0 };
+    char length[48];
+    const char *piece[3];
+    size_t size[3];
+    size_t total = 0;
+    int i = 0;
+    int cnt = 0;
+    int nhdr = 0;
+    size_t off = 0;
+    piece[0] = head->data;
+    size[0] = head->len;
+    piece[1] = length;
+    size[1] = 0;
+    piece[2] = body->data;
+    size[2] = body->len;
+    if (head->failed || body->failed) {
+        piece[0] = error;
+        size[0] = sizeof(error) - 1;
+        size[2] = 0;
+        status = 1;
+    }
+    else if (head->len) {
+        size[1] = (size_t) snprintf(length, sizeof(length),
+                "Content-Length: %lu\n\n", (unsigned long) body->len);
+    }
+    total = size[0] + size[1] + size[2];
+    while (total) {
+        /* one record: header and up to three slices */
+        size_t len = total < NANABOZO_FCGI_MAX_CONTENT
+            ? total : NANABOZO_FCGI_MAX_CONTENT;
+        size_t left = len;
+        if (cnt + 4 > NANABOZO_FCGI_IOV) {
+            if (nanabozo_buffer_writev(c->fd, iov, cnt) != 0) {
+                return -1;
+            }
+            cnt = nhdr = 0;
+        }
+        nanabozo_fastcgi_header(hdrs[nhdr], NANABOZO_FCGI_STDOUT, c->id, len);
+        iov[cnt].iov_base = hdrs[nhdr++];
+        iov[cnt++].iov_len = 8;
+        while (left) {
+            size_t k = size[i] - off < left ? size[i] - off : left;
+            if (k) {
+                iov[cnt].iov_base = (char *) piece[i] + off;
+                iov[cnt++].iov_len = k;
+            }
+            off += k;
+            left -= k;
+            if (off == size[i]) {
+                i++;
+                off = 0;
+            }
+        }
+        total -= len;
+    }
+    if (cnt == NANABOZO_FCGI_IOV) {
+        if (nanabozo_buffer_writev(c->fd, iov, cnt) != 0) {
+            return -1;
+        }
+        cnt = 0;
+    }
+    /* empty FCGI_STDOUT, then FCGI_END_REQUEST */
+    nanabozo_fastcgi_header(end, NANABOZO_FCGI_STDOUT, c->id, 0);
+    nanabozo_fastcgi_header(end + 8, NANABOZO_FCGI_END_REQUEST, c->id, 8);
+    end[16] = (unsigned char) ((unsigned) status >> 24);
+    end[17] = (unsigned char) ((unsigned) status >> 16);
+    end[18] = (unsigned char) ((unsigned) status >> 8);
+    end[19] = (unsigned char) status;
+    end[20] = NANABOZO_FCGI_REQUEST_COMPLETE;
+    iov[cnt].iov_base = end;
+    iov[cnt++].iov_len = 24;
+    c->id = 0;
+    return nanabozo_buffer_writev(c->fd, iov, cnt);
+}
+
+/* listening socket, -1 on error */
+static int nanabozo_fastcgi_listen( void )
+{
+    const char *addr = getenv("NANABOZO_FASTCGI");
+    struct addrinfo hints;
+    struct addrinfo *res;
+    struct addrinfo *ai;
+    char host[256];
+    const char *port;
+    int fd = -1;
+    int on = 1;
+    if (!addr || !*addr) {
+        struct sockaddr_storage sa;
+        socklen_t len = sizeof(sa);
+        if (getsockname(0, (struct sockaddr *) &sa, &len) == 0) {
+            return 0;
+        }
+        fputs("nanabozo_fastcgi: no socket on stdin, "
+                "and NANABOZO_FASTCGI is not set\n", stderr);
+        return -1;
+    }
+    if (strchr(addr, '/')) {
+        struct sockaddr_un un;
+        if (strlen(addr) >= sizeof(un.sun_path)
+            || (fd = socket(AF_UNIX, SOCK_STREAM, 0)) < 0)
+        {
+            perror("nanabozo_fastcgi");
+            return -1;
+        }
+        memset(&un, 0, sizeof(un));
+        un.sun_family = AF_UNIX;
+        strcpy(un.sun_path, addr);
+        unlink(addr);
+        if (bind(fd, (struct sockaddr *) &un, sizeof(un)) != 0
+            || listen(fd, SOMAXCONN) != 0)
+        {
+            perror("nanabozo_fastcgi");
+            close(fd);
+            return -1;
+        }
+        return fd;
+    }
+    if (!(port = strrchr(addr, ':')) || (size_t) (port - addr) >= sizeof(host)) {
+        fprintf(stderr, "nanabozo_fastcgi: invalid address '%s'\n", addr);
+        return -1;
+    }
+    memcpy(host, addr, (size_t) (port - addr));
+    host[port - addr] = '\0';
+    port++;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_flags = AI_PASSIVE;
+    if (getaddrinfo(*host ? host : NULL, port, &hints, &res) != 0) {
+        fprintf(stderr, "nanabozo_fastcgi: invalid address '%s'\n", addr);
+        return -1;
+    }
+    for (ai = res; ai; ai = ai->ai_next) {
+        if ((fd = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol)) < 0) {
+            continue;
+        }
+        setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+        if (bind(fd, ai->ai_addr, ai->ai_addrlen) == 0
+            && listen(fd, SOMAXCONN) == 0)
+        {
+            break;
+        }
+        close(fd);
+        fd = -1;
+    }
+    freeaddrinfo(res);
+    if (fd < 0) {
+        perror("nanabozo_fastcgi");
+    }
+    return fd;
+}
+
+/*
+ *  Serve requests forever, calling handler for each one after emptying
+ *  head and body, the buffers it prints to. Return only on error.
+ */
+static int nanabozo_fastcgi_run( int (*handler)( void ),
+        struct nanabozo_buffer *head, struct nanabozo_buffer *body )
+{
+    struct nanabozo_fastcgi *c = &nanabozo_fastcgi_conn;
+    int lfd = nanabozo_fastcgi_listen();
+    if (lfd < 0) {
+        return EXIT_FAILURE;
+    }
+    signal(SIGPIPE, SIG_IGN);
+    for (;;) {
+        if ((c->fd = accept(lfd, NULL, NULL)) < 0) {
+            if (errno == EINTR || errno == ECONNABORTED) {
+                continue;
+            }
+            perror("nanabozo_fastcgi");
+            return EXIT_FAILURE;
+        }
+        c->rpos = c->rlen = 0;
+        c->id = 0;
+        while (nanabozo_fastcgi_accept(c)) {
+            int status;
+            nanabozo_buffer_reset(head);
+            nanabozo_buffer_reset(body);
+            status = handler();
+            if (nanabozo_fastcgi_respond(c, head, body, status) != 0
+                || !c->keep_conn)
+            {
+                break;
+            }
+        }
+        close(c->fd);
+    }
+}
+
+#endif /* NANABOZO_FASTCGI_H */
+
+/* vi: set fenc=utf-8 ff=unix sw=4 ts=4 sts=4 et ai : */
@@ -0,0 +1,140 @@
+/*
+    nanabozo - tool for CHTML script-coding
+    Copyright (C) 2018-2020 Stanislas Marquis <stan@astrorigin.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+/*
+ *  nanabozo_format - number writers for the <?%d ?> tags (C99 or C++)
+ *
+ *  Integers are written without printf: no format parsing, no locale.
+ *  Digits go two at a time from a table, right to left, in a buffer of
+ *  the caller that is nul terminated:
+ *
+ *      char buf[NANABOZO_FORMAT_INT];
+ *      size_t n = nanabozo_format_d(buf, -42);
+ *      fwrite(buf, 1, n, stdout);
+ */
+
+#ifndef NANABOZO_FORMAT_H
+#define NANABOZO_FORMAT_H
+
+#include <stddef.h>
+#include <string.h>  /* memcpy, for compiled formats */
+
+#define NANABOZO_FORMAT_INT 24  /* room for any 64-bit integer, and a nul */
+
+/* v as unsigned of its promoted width, as printf %u and %x take it (-1 is
+   ffffffff for an int), v is evaluated once (sizeof does not evaluate),
+   wider types (__int128) are cut to their low 64 bits */
+#define NANABOZO_FORMAT_UNSIGNED(v) \
+    ((unsigned long long) (v) & (~0ULL >> \
+        (sizeof((v) + 0) >= sizeof(unsigned long long) ? 0 \
+         : 8 * (sizeof(unsigned long long) - sizeof((v) + 0)))))
+
+static const char nanabozo_format_pairs[201] =
+    "00010203040506070809"
+    "10111213141516171819"
+    "20212223242526272829"
+    "30313233343536373839"
+    "40414243444546474849"
+    "50515253545556575859"
+    "60616263646566676869"
+    "70717273747576777879"
+    "80818283848586878889"
+    "90919293949596979899";
+
+/* number of decimal digits of v */
+static inline size_t nanabozo_format_digits( unsigned long long v )
+{
+    size_t n = 1;
+    for (;;) {
+        if (v < 10) {
+            return n;
+        }
+        if (v < 100) {
+            return n + 1;
+        }
+        if (v < 1000) {
+            return n + 2;
+        }
+        if (v < 10000) {
+            return n + 3;
+        }
+        v /= 10000;
+        n += 4;
+    }
+}
+
+/* unsigned decimal, return the length */
+static inline size_t nanabozo_format_u( char *buf, unsigned long long v )
+{
+    const size_t len = nanabozo_format_digits(v);
+    char *p = buf + len;
+    *p = '\0';
+    while (v >= 100) {
+        const unsigned i = (unsigned) (v % 100) * 2;
+        v /= 100;
+        *--p = nanabozo_format_pairs[i + 1];
+        *--p = nanabozo_format_pairs[i];
+    }
+    if (v >= 10) {
+        *--p = nanabozo_format_pairs[v * 2 + 1];
+        *--p = nanabozo_format_pairs[v * 2];
+    }
+    else {
+        *--p = (char) ('0' + v);
+    }
+    return len;
+}
+
+/* signed decimal, return the length */
+static inline size_t nanabozo_format_d( char *buf, long long v )
+{
+    if (v < 0) {
+        *buf = '-';
+        /* negated as unsigned, for the smallest value */
+        return nanabozo_format_u(buf + 1, 0ULL - (unsigned long long) v) + 1;
+    }
+    return nanabozo_format_u(buf, (unsigned long long) v);
+}
+
+/* lowercase hexadecimal, return the length */
+static inline size_t nanabozo_format_x( char *buf, unsigned long long v )
+{
+    static const char hex[] = "0123456789abcdef";
+    size_t len;
+    char *p;
+#ifdef __GNUC__
+    len = (size_t) (67 - __builtin_clzll(v | 1)) / 4;
+#else
+    unsigned long long w = v >> 4;
+    for (len = 1; w; w >>= 4) {
+        len++;
+    }
+#endif
+    p = buf + len;
+    *p = '\0';
+    do {
+        *--p = hex[v & 15];
+        v >>= 4;
+    } while (p != buf);
+    return len;
+}
+
+#endif /* NANABOZO_FORMAT_H */
+
+/* vi: set fenc=utf-8 ff=unix sw=4 ts=4 sts=4 et ai : */
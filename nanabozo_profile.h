@@ -0,0 +1,181 @@
+/*
+    nanabozo - tool for CHTML script-coding
+    Copyright (C) 2018-2020 Stanislas Marquis <stan@astrorigin.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+/*
+ *  nanabozo_profile - timing of the regions of generated pages (C99 or C++)
+ *
+ *  With the option --profile-regions, each html literal and each <?= ?>,
+ *  <?- ?>, <?% ?> and <?%d ?> tag is put between NANABOZO_PROFILE_BEGIN and
+ *  NANABOZO_PROFILE_END. A region counts its calls and the ticks spent in
+ *  it, in a static record registered on its first call. At exit, records
+ *  are dumped to stderr, or appended to the file named by the environment
+ *  variable NANABOZO_PROFILE, in a single write, one line per region:
+ *
+ *      page.php:12 html 1000 84211
+ *
+ *  Ticks are read with rdtsc on x86 (GCC and Clang), elsewhere or when
+ *  NANABOZO_PROFILE_NS is defined they are nanoseconds of the monotonic
+ *  clock. Regions are keyed by the line of the script and by
+ *  NANABOZO_PROFILE_FILE, the name of the script that the generated code
+ *  defines unless defined before (cc -D), or __FILE__ for a script read
+ *  from stdin. Regions of partials are keyed by the name of the partial,
+ *  one record per include. Records are not locked, profile threaded
+ *  pages one thread at a time.
+ */
+
+#ifndef NANABOZO_PROFILE_H
+#define NANABOZO_PROFILE_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__) \
+    && !defined(NANABOZO_PROFILE_NS)
+#include <x86intrin.h>
+#define NANABOZO_PROFILE_UNIT "tsc"
+#else
+#define NANABOZO_PROFILE_UNIT "ns"
+#endif
+
+#ifndef NANABOZO_PROFILE_FILE
+#define NANABOZO_PROFILE_FILE __FILE__
+#endif
+
+struct nanabozo_profile
+{
+    const char *file;
+    unsigned long line;
+    const char *kind;       /* html, C=, C-, C%, C%d... */
+    unsigned long long calls;
+    unsigned long long ticks;
+    struct nanabozo_profile *next;
+    int registered;
+};
+
+/* regions of this translation unit, in the order of their first call */
+static struct nanabozo_profile *nanabozo_profile_regions = NULL;
+static struct nanabozo_profile **nanabozo_profile_last =
+    &nanabozo_profile_regions;
+
+static inline unsigned long long nanabozo_profile_ticks( void )
+{
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__) \
+    && !defined(NANABOZO_PROFILE_NS)
+    return __rdtsc();
+#elif defined(_WIN32)
+    struct timespec ts;
+    timespec_get(&ts, TIME_UTC);
+    return (unsigned long long) ts.tv_sec * 1000000000ULL
+        + (unsigned long long) ts.tv_nsec;
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (unsigned long long) ts.tv_sec * 1000000000ULL
+        + (unsigned long long) ts.tv_nsec;
+#endif
+}
+
+/* all records, as lines, to f, in one write, return 0 or -1 */
+static inline int nanabozo_profile_write( FILE *f )
+{
+    const struct nanabozo_profile *r;
+    size_t len = 0, cap = 256;
+    char *buf, *p;
+    int n;
+
+    if (!(buf = (char*) malloc(cap))) {
+        return -1;
+    }
+    len = (size_t) snprintf(buf, cap, "# nanabozo profile: file:line kind"
+            " calls ticks (%s)\n", NANABOZO_PROFILE_UNIT);
+    for (r = nanabozo_profile_regions; r; r = r->next) {
+        for (;;) {
+            n = snprintf(buf + len, cap - len, "%s:%lu %s %llu %llu\n",
+                    r->file, r->line, r->kind, r->calls, r->ticks);
+            if (n < 0) {
+                free(buf);
+                return -1;
+            }
+            if ((size_t) n < cap - len) {
+                len += (size_t) n;
+                break;
+            }
+            if (!(p = (char*) realloc(buf, cap * 2))) {
+                free(buf);
+                return -1;
+            }
+            buf = p;
+            cap *= 2;
+        }
+    }
+    n = fwrite(buf, 1, len, f) == len && fflush(f) == 0 ? 0 : -1;
+    free(buf);
+    return n;
+}
+
+static inline void nanabozo_profile_dump( void )
+{
+    const char *path = getenv("NANABOZO_PROFILE");
+    FILE *f;
+
+    if (!path || !*path) {
+        nanabozo_profile_write(stderr);
+    }
+    else if ((f = fopen(path, "a"))) {
+        /* unbuffered, the lines of concurrent processes do not mix */
+        setvbuf(f, NULL, _IONBF, 0);
+        nanabozo_profile_write(f);
+        fclose(f);
+    }
+}
+
+static inline unsigned long long nanabozo_profile_enter(
+        struct nanabozo_profile *r )
+{
+    if (!r->registered) {
+        if (!nanabozo_profile_regions) {
+            atexit(&nanabozo_profile_dump);
+        }
+        r->registered = 1;
+        *nanabozo_profile_last = r;
+        nanabozo_profile_last = &r->next;
+    }
+    return nanabozo_profile_ticks();
+}
+
+static inline void nanabozo_profile_leave( struct nanabozo_profile *r,
+        unsigned long long t0 )
+{
+    r->ticks += nanabozo_profile_ticks() - t0;
+    r->calls++;
+}
+
+/* a block around the code of a region */
+#define NANABOZO_PROFILE_BEGIN(file, kind, line) \
+    { static struct nanabozo_profile nanabozo_r = \
+        { file, line, kind, 0, 0, NULL, 0 }; \
+    const unsigned long long nanabozo_t0 = nanabozo_profile_enter(&nanabozo_r);
+
+#define NANABOZO_PROFILE_END \
+    nanabozo_profile_leave(&nanabozo_r, nanabozo_t0); }
+
+#endif /* NANABOZO_PROFILE_H */
+
+/* vi: set fenc=utf-8 ff=unix sw=4 ts=4 sts=4 et ai : */
@@ -0,0 +1,58 @@
+#!/bin/sh
+#
+#  nanabozo golden outputs
+#
+#  usage: tests/check.sh <nanabozo> [-u]
+#
+#  Each tests/<name>.php is translated with -d, and the options of
+#  <name>.args if any, and compared with <name>.c, or with the messages of
+#  <name>.err when the script is refused. With -u, the outputs are written
+#  instead, to be reviewed with git diff.
+#
+
+case "$1" in
+/*) B="$1" ;;
+"") echo "usage: $0 <nanabozo> [-u]" >&2; exit 2 ;;
+*) B="$(pwd)/$1" ;;
+esac
+update="$2"
+out="${TMPDIR:-/tmp}/nanabozo_check.$$"
+trap 'rm -f "$out" "$out.err"' EXIT
+
+# partials and names of scripts are relative to this directory
+cd "$(dirname "$0")" || exit 2
+pass=0
+fail=0
+for f in *.php; do
+    n="${f%.php}"
+    args=""
+    if [ -f "$n.args" ]; then
+        args="$(cat "$n.args")"
+    fi
+    # shellcheck disable=SC2086
+    if "$B" -d $args "$f" > "$out" 2> "$out.err"; then
+        expect="$n.c"
+    else
+        expect="$n.err"
+        mv -f "$out.err" "$out"
+    fi
+    if [ "$update" = "-u" ]; then
+        rm -f "$n.c" "$n.err"
+        cp "$out" "$expect"
+    elif [ -f "$expect" ] && cmp -s "$out" "$expect"; then
+        pass=$((pass + 1))
+    else
+        echo "FAIL $n ($expect)"
+        if [ -f "$expect" ]; then
+            diff -u "$expect" "$out" | head -40
+        fi
+        fail=$((fail + 1))
+    fi
+done
+if [ "$update" = "-u" ]; then
+    exit 0
+fi
+echo "$pass passed, $fail failed"
+[ "$fail" = 0 ]
+
+# vi: sw=4 ts=4 et
@@ -0,0 +1,68 @@
+/*
+ *	Generated by nanabozo (do not edit)
+ */
+
+#include <stdio.h>
+#define print(x) fputs(x, stdout)
+
+#include <nanabozo_escape.h>
+
+/* BEGIN C (line 1) */
+    const char *s = "a'b\"c<&>";
+/* END C (line 3) */
+print("<p>");
+/* BEGIN C- (line 4) */
+{ struct nanabozo_escape nanabozo_e;
+nanabozo_escape_init(&nanabozo_e, ( s ));
+while (nanabozo_escape_html(&nanabozo_e)) print(nanabozo_e.out); }
+/* END C- (line 4) */
+print("</p>\n"
+"<input value=\"");
+/* BEGIN C- (line 5) */
+{ struct nanabozo_escape nanabozo_e;
+nanabozo_escape_init(&nanabozo_e, ( s ));
+while (nanabozo_escape_attr(&nanabozo_e)) print(nanabozo_e.out); }
+/* END C- (line 5) */
+print("\" title='");
+/* BEGIN C- (line 5) */
+{ struct nanabozo_escape nanabozo_e;
+nanabozo_escape_init(&nanabozo_e, ( s ));
+while (nanabozo_escape_attr(&nanabozo_e)) print(nanabozo_e.out); }
+/* END C- (line 5) */
+print("'>\n"
+"<a onclick=\"f('");
+/* BEGIN C- (line 6) */
+{ struct nanabozo_escape nanabozo_e;
+nanabozo_escape_init(&nanabozo_e, ( s ));
+while (nanabozo_escape_js_attr(&nanabozo_e)) print(nanabozo_e.out); }
+/* END C- (line 6) */
+print("')\">x</a>\n"
+"<script>\n"
+"var a = \"");
+/* BEGIN C- (line 8) */
+{ struct nanabozo_escape nanabozo_e;
+nanabozo_escape_init(&nanabozo_e, ( s ));
+while (nanabozo_escape_js(&nanabozo_e)) print(nanabozo_e.out); }
+/* END C- (line 8) */
+print("\", b = '");
+/* BEGIN C- (line 8) */
+{ struct nanabozo_escape nanabozo_e;
+nanabozo_escape_init(&nanabozo_e, ( s ));
+while (nanabozo_escape_js(&nanabozo_e)) print(nanabozo_e.out); }
+/* END C- (line 8) */
+print("', c = `");
+/* BEGIN C- (line 8) */
+{ struct nanabozo_escape nanabozo_e;
+nanabozo_escape_init(&nanabozo_e, ( s ));
+while (nanabozo_escape_js(&nanabozo_e)) print(nanabozo_e.out); }
+/* END C- (line 8) */
+print("`;\n"
+"var d = \"");
+/* BEGIN C- (line 9) */
+{ struct nanabozo_escape nanabozo_e;
+nanabozo_escape_init(&nanabozo_e, ( s ));
+while (nanabozo_escape_js(&nanabozo_e)) print(nanabozo_e.out); }
+/* END C- (line 9) */
+print("\";\n"
+"</script>\n"
+"<style>p::before { content: \"<?- s ?>\"; }</style>\n");
@@ -0,0 +1,11 @@
+<?
+    const char *s = "a'b\"c<&>";
+?>
+<p><?- s ?></p>
+<input value="<?- s ?>" title='<?- s ?>'>
+<a onclick="f('<?- s ?>')">x</a>
+<script>
+var a = "<?- s ?>", b = '<?- s ?>', c = `<?- s ?>`;
+var d = <?- s ?>;
+</script>
+<style>p::before { content: "<?- s ?>"; }</style>
@@ -0,0 +1 @@
+<p style="color: <?- s ?>">x</p>
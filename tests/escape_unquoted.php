@@ -0,0 +1 @@
+<input value=<?- s ?>>
@@ -0,0 +1,29 @@
+/*
+ *	Generated by nanabozo (do not edit)
+ */
+
+#include <stdio.h>
+#define print(x) fputs(x, stdout)
+#define print_n(x, n) fwrite(x, 1, n, stdout)
+
+#include <nanabozo_format.h>
+
+/* BEGIN C% (line 1) */
+{ const char *nanabozo_a0 = ( name);
+unsigned long nanabozo_a1 = ( count);
+int nanabozo_a2 = ( c );
+print_n("<td>", 4);
+print(nanabozo_a0 ? nanabozo_a0 : "(null)");
+{ char nanabozo_o[24 + 2 * NANABOZO_FORMAT_INT];
+size_t nanabozo_n = 0;
+memcpy(nanabozo_o + nanabozo_n, "</td><td>", 9);
+nanabozo_n += 9;
+nanabozo_n += nanabozo_format_u(nanabozo_o + nanabozo_n, nanabozo_a1);
+memcpy(nanabozo_o + nanabozo_n, "</td><td>", 9);
+nanabozo_n += 9;
+nanabozo_o[nanabozo_n++] = (char) nanabozo_a2;
+memcpy(nanabozo_o + nanabozo_n, "</td>", 5);
+nanabozo_n += 5;
+print_n(nanabozo_o, nanabozo_n); }
+}
+/* END C% (line 1) */
\ No newline at end of file
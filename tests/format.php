@@ -0,0 +1 @@
+<?% "<td>%s</td><td>%lu</td><td>%c</td>", name, count, c ?>
@@ -0,0 +1 @@
+<h1><?= title ?></h1>
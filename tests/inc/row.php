@@ -0,0 +1 @@
+<p><?%d i ?></p>
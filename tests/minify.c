@@ -0,0 +1,28 @@
+/*
+ *	Generated by nanabozo (do not edit)
+ */
+
+#include <stdio.h>
+#define print(x) fputs(x, stdout)
+
+
+print("<!DOCTYPE html>\n"
+"<html>\n"
+"<!--[if IE]>kept<![endif]-->\n"
+"<body class=\"a   b\">\n"
+"<p>\n"
+"text ");
+/* BEGIN C= (line 7) */
+print( s );
+/* END C= (line 7) */
+print(" more\n"
+"</p>\n"
+"<pre>  a  <!-- kept -->  b  </pre>\n"
+"<script>\n"
+"var x = \"  /* kept */  \";\n"
+"</script>\n"
+"<style>\n"
+"p { color: red; }\n"
+"</style>\n"
+"</body>\n"
+"</html>\n");
@@ -0,0 +1,18 @@
+<!DOCTYPE html>
+<html>
+  <!-- dropped -->
+  <!--[if IE]>kept<![endif]-->
+  <body   class="a   b">
+    <p>
+      text    <?= s ?>   more
+    </p>
+    <pre>  a  <!-- kept -->  b  </pre>
+    <script>
+      // dropped
+      var x = "  /* kept */  "; /* dropped */
+    </script>
+    <style>
+      /* dropped */ p { color: red; }
+    </style>
+  </body>
+</html>
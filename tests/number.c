@@ -0,0 +1,49 @@
+/*
+ *	Generated by nanabozo (do not edit)
+ */
+
+#include <stdio.h>
+#define print(x) fputs(x, stdout)
+
+#include <nanabozo_format.h>
+
+
+print("<tr data-id=\"");
+/* BEGIN C%u (line 1) */
+{ char nanabozo_i[NANABOZO_FORMAT_INT];
+nanabozo_format_u(nanabozo_i, NANABOZO_FORMAT_UNSIGNED(id ));
+print(nanabozo_i); }
+/* END C%u (line 1) */
+print("\" data-n=");
+/* BEGIN C%d (line 1) */
+{ char nanabozo_i[NANABOZO_FORMAT_INT];
+nanabozo_format_d(nanabozo_i, (n ));
+print(nanabozo_i); }
+/* END C%d (line 1) */
+print("><td>");
+/* BEGIN C%x (line 1) */
+{ char nanabozo_i[NANABOZO_FORMAT_INT];
+nanabozo_format_x(nanabozo_i, NANABOZO_FORMAT_UNSIGNED(mask ));
+print(nanabozo_i); }
+/* END C%x (line 1) */
+print("</td></tr>\n"
+"<script>var id = ");
+/* BEGIN C%d (line 2) */
+{ char nanabozo_i[NANABOZO_FORMAT_INT];
+nanabozo_format_d(nanabozo_i, (id ));
+print(nanabozo_i); }
+/* END C%d (line 2) */
+print(", s = \"");
+/* BEGIN C%x (line 2) */
+{ char nanabozo_i[NANABOZO_FORMAT_INT];
+nanabozo_format_x(nanabozo_i, NANABOZO_FORMAT_UNSIGNED(mask ));
+print(nanabozo_i); }
+/* END C%x (line 2) */
+print("\";</script>\n"
+"<style>p { width: ");
+/* BEGIN C%u (line 3) */
+{ char nanabozo_i[NANABOZO_FORMAT_INT];
+nanabozo_format_u(nanabozo_i, NANABOZO_FORMAT_UNSIGNED(n ));
+print(nanabozo_i); }
+/* END C%u (line 3) */
+print("px; }</style>\n");
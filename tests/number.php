@@ -0,0 +1,3 @@
+<tr data-id="<?%u id ?>" data-n=<?%d n ?>><td><?%x mask ?></td></tr>
+<script>var id = <?%d id ?>, s = "<?%x mask ?>";</script>
+<style>p { width: <?%u n ?>px; }</style>
@@ -0,0 +1,31 @@
+/*
+ *	Generated by nanabozo (do not edit)
+ */
+
+#include <stdio.h>
+#define print(x) fputs(x, stdout)
+
+#include <nanabozo_format.h>
+
+/* BEGIN C (line 1) */
+ int i; /* END C (line 1) *//* BEGIN INCLUDE "inc/head.php" (line 2) */
+
+print("<h1>");
+/* BEGIN C= (line 1) */
+print( title );
+/* END C= (line 1) */
+print("</h1>\n");
+
+/* END INCLUDE "inc/head.php" (line 2) *//* BEGIN C (line 3) */
+ for (i = 0; i < 2; i++) { /* END C (line 3) *//* BEGIN INCLUDE "inc/row.php" (line 4) */
+
+print("<p>");
+/* BEGIN C%d (line 1) */
+{ char nanabozo_i[NANABOZO_FORMAT_INT];
+nanabozo_format_d(nanabozo_i, (i ));
+print(nanabozo_i); }
+/* END C%d (line 1) */
+print("</p>\n");
+
+/* END INCLUDE "inc/row.php" (line 4) *//* BEGIN C (line 5) */
+ } /* END C (line 5) */
\ No newline at end of file
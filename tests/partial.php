@@ -0,0 +1,5 @@
+<? int i; ?>
+<?include "inc/head.php" ?>
+<? for (i = 0; i < 2; i++) { ?>
+<?include "inc/row.php" ?>
+<? } ?>